@@ -0,0 +1,326 @@
+#ifndef FRAMEEXPORT_CPP
+#define FRAMEEXPORT_CPP
+
+#include "FrameExport.h"
+#include "InputQueue.h" // inputNow()
+#include <cstring>
+#include <cstdio>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const size_t framePageSize = 4096;
+
+static inline size_t alignUp(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+// --- SharedMapping ---
+
+#ifdef _WIN32
+
+bool SharedMapping::create(const char* n, size_t bytes, bool allowExisting) {
+    close();
+    HANDLE h = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, n);
+    if (!h) return false;
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS; // a reader still holds it open
+    if (existed && !allowExisting) { CloseHandle(h); return false; }
+    void* p = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, existed ? 0 : bytes);
+    if (!p) { CloseHandle(h); return false; }
+    if (existed) {
+        // The existing object keeps its old size; it can only be reused if big enough
+        MEMORY_BASIC_INFORMATION mbi;
+        if (!VirtualQuery(p, &mbi, sizeof(mbi)) || mbi.RegionSize < bytes) {
+            UnmapViewOfFile(p);
+            CloseHandle(h);
+            return false;
+        }
+    }
+    base = p; size = bytes; handle = h; owner = true;
+    snprintf(name, sizeof(name), "%s", n);
+    return true;
+}
+
+bool SharedMapping::open(const char* n, size_t minSize) {
+    close();
+    HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, n);
+    if (!h) return false;
+    void* p = MapViewOfFile(h, FILE_MAP_READ, 0, 0, 0);
+    if (!p) { CloseHandle(h); return false; }
+    MEMORY_BASIC_INFORMATION mbi;
+    if (!VirtualQuery(p, &mbi, sizeof(mbi)) || mbi.RegionSize < minSize) {
+        UnmapViewOfFile(p);
+        CloseHandle(h);
+        return false;
+    }
+    base = p; size = 0; handle = h; owner = false;
+    snprintf(name, sizeof(name), "%s", n);
+    return true;
+}
+
+void SharedMapping::close() {
+    if (base) UnmapViewOfFile(base);
+    if (handle) CloseHandle((HANDLE)handle);
+    base = nullptr; handle = nullptr; size = 0; owner = false;
+}
+
+#else
+
+bool SharedMapping::create(const char* n, size_t bytes, bool) {
+    close();
+    snprintf(name, sizeof(name), "%s%s", n[0] == '/' ? "" : "/", n);
+    shm_unlink(name); // drop a stale object left by a crashed producer
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)bytes) != 0) { ::close(fd); shm_unlink(name); return false; }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) { shm_unlink(name); return false; }
+    base = p; size = bytes; owner = true;
+    return true;
+}
+
+bool SharedMapping::open(const char* n, size_t minSize) {
+    close();
+    snprintf(name, sizeof(name), "%s%s", n[0] == '/' ? "" : "/", n);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < minSize) { ::close(fd); return false; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    base = p; size = (size_t)st.st_size; owner = false;
+    return true;
+}
+
+void SharedMapping::close() {
+    if (base) munmap(base, size);
+    if (owner) shm_unlink(name);
+    base = nullptr; size = 0; owner = false;
+}
+
+#endif
+
+// --- FrameExportWriter ---
+
+bool FrameExportWriter::open(const char* n, int width, int height, int slots) {
+    close();
+    snprintf(name, sizeof(name), "%s", n);
+    slotCount = slots < 2 ? 2 : (slots > FRAME_EXPORT_MAX_SLOTS ? FRAME_EXPORT_MAX_SLOTS : slots);
+    frameCounter = 0;
+
+    if (!control.create(name, sizeof(FrameExportControl), true)) return false;
+    controlBlock = static_cast<FrameExportControl*>(control.base);
+    // A reader may have kept the block of an earlier run alive; carry its
+    // generation on so ring names are never reused
+    bool reused = controlBlock->magic == FRAME_EXPORT_MAGIC && controlBlock->version == FRAME_EXPORT_VERSION;
+    generation = reused ? controlBlock->generation.load(std::memory_order_relaxed) : 0;
+    controlBlock->magic   = FRAME_EXPORT_MAGIC;
+    controlBlock->version = FRAME_EXPORT_VERSION;
+    controlBlock->generation.store(generation, std::memory_order_release);
+
+    if (!allocate((size_t)width * height)) { close(); return false; }
+    return true;
+}
+
+bool FrameExportWriter::allocate(size_t capacity) {
+    // The old ring stays mapped until its latest frame has been carried over
+    SharedMapping old = mapping;
+    FrameExportHeader* oldHeader = header;
+    mapping = SharedMapping();
+    header = nullptr;
+    if (capacity == 0) capacity = 1;
+
+    size_t pixelsOffset = alignUp(sizeof(FrameExportHeader), framePageSize);
+    size_t slotBytes    = alignUp(capacity * sizeof(uint32_t), framePageSize);
+
+    // Each ring gets a fresh name; one still held open by a reader is skipped
+    char ringName[160];
+    bool created = false;
+    for (int attempt = 0; attempt < 16 && !created; ++attempt) {
+        snprintf(ringName, sizeof(ringName), "%s.%u", name, ++generation);
+        created = mapping.create(ringName, pixelsOffset + slotBytes * slotCount);
+    }
+    if (!created) {
+        if (oldHeader) oldHeader->closed.store(1, std::memory_order_release);
+        old.close();
+        return false;
+    }
+
+    header = new (mapping.base) FrameExportHeader();
+    header->magic        = FRAME_EXPORT_MAGIC;
+    header->version      = FRAME_EXPORT_VERSION;
+    header->slotCount    = slotCount;
+    header->slotCapacity = (uint32_t)capacity;
+    header->slotBytes    = slotBytes;
+    header->pixelsOffset = pixelsOffset;
+    header->latestFrame.store(0, std::memory_order_relaxed);
+    header->latestSlot.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < FRAME_EXPORT_MAX_SLOTS; ++i) {
+        header->slots[i].seq.store(0, std::memory_order_relaxed);
+    }
+    currentSlot = 0;
+    inFrame = false;
+
+    if (oldHeader) {
+        // The latest frame becomes slot 0 of the new ring, so neither readers nor
+        // the renderer lose it. The old ring is only ever smaller than this one.
+        uint64_t latest = oldHeader->latestFrame.load(std::memory_order_relaxed);
+        if (latest != 0) {
+            const FrameSlotHeader& from = oldHeader->slots[oldHeader->latestSlot.load(std::memory_order_relaxed)];
+            const char* src = static_cast<const char*>(old.base) + oldHeader->pixelsOffset
+                            + oldHeader->slotBytes * oldHeader->latestSlot.load(std::memory_order_relaxed);
+            memcpy(slotPixels(0), src, (size_t)from.width * from.height * sizeof(uint32_t));
+            FrameSlotHeader& to = header->slots[0];
+            to.frame     = from.frame;
+            to.timestamp = from.timestamp;
+            to.width     = from.width;
+            to.height    = from.height;
+            to.seq.store(2, std::memory_order_relaxed);
+            header->latestSlot.store(0, std::memory_order_relaxed);
+            header->latestFrame.store(latest, std::memory_order_relaxed);
+        }
+        oldHeader->closed.store(1, std::memory_order_release);
+        old.close();
+    }
+
+    // Readers pick the new ring up from here
+    controlBlock->generation.store(generation, std::memory_order_release);
+    return true;
+}
+
+void FrameExportWriter::close() {
+    if (header) header->closed.store(1, std::memory_order_release);
+    mapping.close();
+    control.close();
+    header = nullptr;
+    controlBlock = nullptr;
+    inFrame = false;
+}
+
+uint32_t* FrameExportWriter::slotPixels(uint32_t slot) const {
+    return reinterpret_cast<uint32_t*>(static_cast<char*>(mapping.base)
+        + header->pixelsOffset + header->slotBytes * slot);
+}
+
+uint32_t* FrameExportWriter::beginFrame(int width, int height) {
+    if (!header) return nullptr;
+    size_t needed = (size_t)width * height;
+    if (needed > header->slotCapacity) {
+        // Round up so a resize drag doesn't reallocate on every step
+        if (!allocate(needed + needed / 4)) return nullptr;
+    }
+    if (inFrame) {
+        // Same slot, only the size changed; its old rows no longer line up
+        FrameSlotHeader& s = header->slots[currentSlot];
+        if ((int)s.width != width || (int)s.height != height) s.frame = 0;
+        s.width  = width;
+        s.height = height;
+        return slotPixels(currentSlot);
+    }
+
+    // Next slot after the last published one
+    currentSlot = (header->latestFrame.load(std::memory_order_relaxed) == 0)
+        ? 0 : (header->latestSlot.load(std::memory_order_relaxed) + 1) % header->slotCount;
+    FrameSlotHeader& s = header->slots[currentSlot];
+    s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // odd: writing
+    std::atomic_thread_fence(std::memory_order_release);
+    if ((int)s.width != width || (int)s.height != height) s.frame = 0; // old content is unusable
+    s.width  = width;
+    s.height = height;
+    inFrame = true;
+    return slotPixels(currentSlot);
+}
+
+void FrameExportWriter::publish() {
+    if (!header || !inFrame) return;
+    FrameSlotHeader& s = header->slots[currentSlot];
+    s.frame = ++frameCounter;
+    s.timestamp = inputNow();
+    s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release); // even: stable
+    header->latestSlot.store(currentSlot, std::memory_order_release);
+    header->latestFrame.store(frameCounter, std::memory_order_release);
+    inFrame = false;
+}
+
+const uint32_t* FrameExportWriter::publishedPixels(int& width, int& height) const {
+    if (!header || header->latestFrame.load(std::memory_order_relaxed) == 0) return nullptr;
+    uint32_t slot = header->latestSlot.load(std::memory_order_relaxed);
+    width  = (int)header->slots[slot].width;
+    height = (int)header->slots[slot].height;
+    return slotPixels(slot);
+}
+
+int FrameExportWriter::currentSlotAge() const {
+    if (!header || !inFrame) return 0;
+    uint64_t latest = header->latestFrame.load(std::memory_order_relaxed);
+    uint64_t held   = header->slots[currentSlot].frame;
+    return (held == 0 || latest == 0 || held >= latest) ? 0 : (int)(latest - held);
+}
+
+// --- FrameExportReader ---
+
+bool FrameExportReader::open(const char* n) {
+    close();
+    if (!control.open(n, sizeof(FrameExportControl))) return false;
+    controlBlock = static_cast<const FrameExportControl*>(control.base);
+    if (controlBlock->magic != FRAME_EXPORT_MAGIC || controlBlock->version != FRAME_EXPORT_VERSION) {
+        close();
+        return false;
+    }
+    generation = controlBlock->generation.load(std::memory_order_acquire);
+    char ringName[160];
+    snprintf(ringName, sizeof(ringName), "%s.%u", n, generation);
+    if (generation == 0 || !mapping.open(ringName, sizeof(FrameExportHeader))) {
+        close(); // not created yet, or already replaced by a newer ring
+        return false;
+    }
+    header = static_cast<const FrameExportHeader*>(mapping.base);
+    if (header->magic != FRAME_EXPORT_MAGIC || header->version != FRAME_EXPORT_VERSION ||
+        header->slotCount == 0 || header->slotCount > FRAME_EXPORT_MAX_SLOTS) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FrameExportReader::close() {
+    mapping.close();
+    control.close();
+    header = nullptr;
+    controlBlock = nullptr;
+    generation = 0;
+}
+
+const uint32_t* FrameExportReader::acquireLatest(FrameInfo& info) const {
+    if (!header || header->latestFrame.load(std::memory_order_acquire) == 0) return nullptr;
+    uint32_t slot = header->latestSlot.load(std::memory_order_acquire);
+    if (slot >= header->slotCount) return nullptr;
+    const FrameSlotHeader& s = header->slots[slot];
+    uint64_t seq = s.seq.load(std::memory_order_acquire);
+    if (seq & 1) return nullptr; // being redrawn
+    info.slot      = slot;
+    info.seq       = seq;
+    info.frame     = s.frame;
+    info.timestamp = s.timestamp;
+    info.width     = (int)s.width;
+    info.height    = (int)s.height;
+    if (!stillValid(info)) return nullptr;
+    return reinterpret_cast<const uint32_t*>(static_cast<const char*>(mapping.base)
+        + header->pixelsOffset + header->slotBytes * slot);
+}
+
+bool FrameExportReader::stillValid(const FrameInfo& info) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header->slots[info.slot].seq.load(std::memory_order_relaxed) == info.seq;
+}
+
+#endif
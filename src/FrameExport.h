@@ -0,0 +1,138 @@
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+// Shared-memory frame ring so another local process (encoder, streamer) can
+// read finished frames without copying them. The renderer draws straight into
+// the slots. No windows.h here; the platform part lives in FrameExport.cpp
+// (file mappings on Windows, shm_open/mmap elsewhere).
+//
+// Protocol: every slot has a seqlock counter that is odd while the producer is
+// drawing into it and even once it is published. A reader picks latestSlot,
+// reads seq (must be even), uses the pixels in place, then re-reads seq; if it
+// changed the producer lapped the ring and the frame must be dropped.
+//
+// The ring lives in its own mapping named "<name>.<generation>". A small control
+// block under the plain name publishes the current generation, so growing the
+// ring never has to reuse a name a reader may still hold open (Windows cannot
+// unlink a named mapping while any handle to it exists).
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define FRAME_EXPORT_MAGIC     0x58463253u // "S2FX"
+#define FRAME_EXPORT_VERSION   2u
+#define FRAME_EXPORT_MAX_SLOTS 8
+
+struct FrameSlotHeader {
+    std::atomic<uint64_t> seq;
+    uint64_t frame;      // frame number, increases by one per publish
+    uint64_t timestamp;  // steady clock nanoseconds at publish
+    uint32_t width;
+    uint32_t height;     // pixels are 0x00BBGGRR, top-down, stride == width
+};
+
+struct FrameExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotCapacity;   // pixels per slot
+    uint64_t slotBytes;      // distance between slots
+    uint64_t pixelsOffset;   // from the start of the mapping to slot 0
+    std::atomic<uint64_t> latestFrame; // 0 = nothing published yet
+    std::atomic<uint32_t> latestSlot;
+    std::atomic<uint32_t> closed;      // set when the producer unmaps or reallocates
+    FrameSlotHeader slots[FRAME_EXPORT_MAX_SLOTS];
+};
+
+struct FrameExportControl {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> generation; // 0 = no ring yet
+};
+
+// Platform shared memory block
+struct SharedMapping {
+    void* base = nullptr;
+    size_t size = 0;
+    void* handle = nullptr; // Windows mapping handle
+    bool owner = false;
+    char name[128] = {};
+
+    // On Windows an object that already has this name is only reused if
+    // allowExisting is set; elsewhere a stale one is replaced
+    bool create(const char* name, size_t size, bool allowExisting = false);
+    bool open(const char* name, size_t minSize); // read-only
+    void close();
+};
+
+// Producer side, used by Window::enableFrameExport
+class FrameExportWriter {
+    public:
+        ~FrameExportWriter() { close(); }
+
+        bool open(const char* name, int width, int height, int slots = 3);
+        void close();
+        // Claim the next slot for drawing; reallocates the ring when it is too small,
+        // carrying the latest published frame over into the new ring
+        uint32_t* beginFrame(int width, int height);
+        void publish();
+        // Latest published frame (stride == width), nullptr before the first publish
+        const uint32_t* publishedPixels(int& width, int& height) const;
+        // How many frames the current slot's old content is behind the latest
+        // published one; 0 if the slot holds nothing usable
+        int currentSlotAge() const;
+
+        inline bool isOpen() const { return header != nullptr; }
+
+    private:
+        bool allocate(size_t capacity);
+        uint32_t* slotPixels(uint32_t slot) const;
+
+        SharedMapping control;
+        SharedMapping mapping;
+        FrameExportControl* controlBlock = nullptr;
+        FrameExportHeader* header = nullptr;
+        char name[128] = {};
+        uint32_t generation = 0;
+        int slotCount = 3;
+        uint32_t currentSlot = 0;
+        uint64_t frameCounter = 0;
+        bool inFrame = false;
+};
+
+struct FrameInfo {
+    uint32_t slot;
+    uint64_t seq;
+    uint64_t frame;
+    uint64_t timestamp;
+    int width, height;
+};
+
+// Consumer side
+class FrameExportReader {
+    public:
+        ~FrameExportReader() { close(); }
+
+        bool open(const char* name);
+        void close();
+        // Newest complete frame, or nullptr if none / currently being overwritten.
+        // The pointer is only trustworthy if stillValid(info) is true after use.
+        const uint32_t* acquireLatest(FrameInfo& info) const;
+        bool stillValid(const FrameInfo& info) const;
+        // The producer went away or reallocated; close() and open() again
+        inline bool isClosed() const {
+            return header && (header->closed.load(std::memory_order_acquire) != 0 ||
+                              controlBlock->generation.load(std::memory_order_acquire) != generation);
+        }
+        inline bool isOpen() const { return header != nullptr; }
+        inline uint32_t getGeneration() const { return generation; }
+
+    private:
+        SharedMapping control;
+        SharedMapping mapping;
+        const FrameExportControl* controlBlock = nullptr;
+        const FrameExportHeader* header = nullptr;
+        uint32_t generation = 0;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+// Platform independent: no windows.h in here so the queue can be built and
+// exercised on its own.
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+enum class InputType : uint8_t {
+    MouseMove,
+    MouseDown,
+    MouseUp,
+    MouseWheel,
+    KeyDown,
+    KeyUp,
+    Char
+};
+
+enum class MouseButton : uint8_t { None, Left, Right, Middle };
+
+struct InputEvent {
+    uint64_t timestamp;  // steady clock, nanoseconds (see inputNow())
+    InputType type;
+    MouseButton button;  // MouseDown / MouseUp
+    bool repeat;         // KeyDown auto-repeat
+    int x, y;            // mouse position in frame coordinates
+    int wheel;           // MouseWheel, in WHEEL_DELTA units (120 per notch)
+    uint32_t key;        // virtual key code for KeyDown / KeyUp, UTF-16 unit for Char
+};
+
+inline uint64_t inputNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Fixed capacity single-producer/single-consumer ring buffer. push() is only
+// called by the producer (the window procedure), pop() only by the consumer
+// (the frame loop). Capacity must be a power of two. When full, new events are
+// dropped and counted rather than overwriting unread ones.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+    public:
+        bool push(const T& item) {
+            size_t head = writeIdx.load(std::memory_order_relaxed);
+            if (head - readIdx.load(std::memory_order_acquire) == Capacity) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            items[head & (Capacity - 1)] = item;
+            writeIdx.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T& out) {
+            size_t tail = readIdx.load(std::memory_order_relaxed);
+            if (tail == writeIdx.load(std::memory_order_acquire)) return false;
+            out = items[tail & (Capacity - 1)];
+            readIdx.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Pop everything currently queued, calling fn(item) for each. Returns the count.
+        template <typename F>
+        size_t drain(F&& fn) {
+            size_t tail = readIdx.load(std::memory_order_relaxed);
+            size_t head = writeIdx.load(std::memory_order_acquire);
+            for (size_t i = tail; i != head; ++i) {
+                fn(items[i & (Capacity - 1)]);
+            }
+            readIdx.store(head, std::memory_order_release);
+            return head - tail;
+        }
+
+        inline size_t size() const {
+            return writeIdx.load(std::memory_order_acquire) - readIdx.load(std::memory_order_acquire);
+        }
+        inline bool empty() const { return size() == 0; }
+        inline size_t capacity() const { return Capacity; }
+        inline uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    private:
+        T items[Capacity];
+        // Keep producer and consumer indices on separate cache lines
+        alignas(64) std::atomic<size_t> writeIdx{0};
+        alignas(64) std::atomic<size_t> readIdx{0};
+        alignas(64) std::atomic<uint64_t> dropped{0};
+};
+
+typedef SpscRing<InputEvent, 1024> InputQueue;
+
+#endif
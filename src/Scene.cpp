@@ -0,0 +1,298 @@
+#ifndef SCENE_CPP
+#define SCENE_CPP
+
+#include "Scene.h"
+
+Scene::Scene(int x, int y, int size, int maxDepth) : maxDepth(std::clamp(maxDepth, 0, 16)) {
+    Node root;
+    root.x = x;
+    root.y = y;
+    root.size = fastMax(1, size);
+    nodes.push_back(root);
+}
+
+int Scene::allocShape() {
+    int id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = (int)shapes.size();
+        shapes.emplace_back();
+    }
+    Shape& s = shapes[id];
+    s.pts.clear();
+    s.z = nextZ++;
+    s.node = -1;
+    ++liveCount;
+    return id;
+}
+
+void Scene::updateBounds(Shape& s) {
+    switch (s.type) {
+        case ShapeType::Rect:
+            s.bounds = { s.x, s.y, s.x + s.w, s.y + s.h };
+            break;
+        case ShapeType::Circle: // antialiased edge reaches one pixel further
+            s.bounds = { s.x - s.w - 1, s.y - s.w - 1, s.x + s.w + 2, s.y + s.w + 2 };
+            break;
+        case ShapeType::Ellipse:
+            s.bounds = { s.x - s.w, s.y - s.h, s.x + s.w + 1, s.y + s.h + 1 };
+            break;
+        case ShapeType::Polygon: {
+            RECT b = { LONG_MAX, LONG_MAX, LONG_MIN, LONG_MIN };
+            for (const POINT& p : s.pts) {
+                b.left   = fastMin(b.left,   p.x);
+                b.top    = fastMin(b.top,    p.y);
+                b.right  = fastMax(b.right,  p.x + 1);
+                b.bottom = fastMax(b.bottom, p.y + 1);
+            }
+            if (s.pts.empty()) b = { s.x, s.y, s.x, s.y };
+            s.bounds = b;
+            break;
+        }
+    }
+}
+
+// Loose quadtree: a node's loose bounds are its cell grown by half a cell on
+// every side, so a shape no larger than a cell always fits the cell holding
+// its center. Each shape lives in exactly one node.
+void Scene::insert(int id) {
+    Shape& s = shapes[id];
+    int extent = fastMax(s.bounds.right - s.bounds.left, s.bounds.bottom - s.bounds.top);
+    int cx = (s.bounds.left + s.bounds.right) / 2;
+    int cy = (s.bounds.top + s.bounds.bottom) / 2;
+
+    int n = 0;
+    for (int depth = 0; depth < maxDepth; ++depth) {
+        int half = nodes[n].size / 2;
+        if (half < 1 || extent > half) break;
+        int nx = nodes[n].x, ny = nodes[n].y;
+        if (cx < nx || cy < ny || cx >= nx + nodes[n].size || cy >= ny + nodes[n].size) break;
+        if (nodes[n].child < 0) {
+            int first = (int)nodes.size();
+            for (int q = 0; q < 4; ++q) {
+                Node c;
+                c.x = nx + (q & 1) * half;
+                c.y = ny + (q >> 1) * half;
+                c.size = half;
+                nodes.push_back(c); // may reallocate, index again below
+            }
+            nodes[n].child = first;
+        }
+        int q = (cx >= nx + half ? 1 : 0) | (cy >= ny + half ? 2 : 0);
+        n = nodes[n].child + q;
+    }
+    nodes[n].items.push_back(id);
+    s.node = n;
+}
+
+void Scene::unlink(int id) {
+    std::vector<int>& items = nodes[shapes[id].node].items;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i] == id) {
+            items[i] = items.back();
+            items.pop_back();
+            break;
+        }
+    }
+    shapes[id].node = -1;
+}
+
+int Scene::addRect(int x, int y, int w, int h, color c) {
+    int id = allocShape();
+    Shape& s = shapes[id];
+    s.type = ShapeType::Rect; s.c = c;
+    s.x = x; s.y = y; s.w = w; s.h = h;
+    updateBounds(s);
+    insert(id);
+    return id;
+}
+
+int Scene::addCircle(int cx, int cy, int radius, color c) {
+    int id = allocShape();
+    Shape& s = shapes[id];
+    s.type = ShapeType::Circle; s.c = c;
+    s.x = cx; s.y = cy; s.w = s.h = radius;
+    updateBounds(s);
+    insert(id);
+    return id;
+}
+
+int Scene::addEllipse(int cx, int cy, int rx, int ry, color c) {
+    int id = allocShape();
+    Shape& s = shapes[id];
+    s.type = ShapeType::Ellipse; s.c = c;
+    s.x = cx; s.y = cy; s.w = rx; s.h = ry;
+    updateBounds(s);
+    insert(id);
+    return id;
+}
+
+int Scene::addPolygon(const std::vector<POINT>& pts, color c) {
+    int id = allocShape();
+    Shape& s = shapes[id];
+    s.type = ShapeType::Polygon; s.c = c;
+    s.pts = pts;
+    s.x = pts.empty() ? 0 : pts[0].x;
+    s.y = pts.empty() ? 0 : pts[0].y;
+    s.w = s.h = 0;
+    updateBounds(s);
+    insert(id);
+    return id;
+}
+
+void Scene::remove(int id) {
+    if (!get(id)) return;
+    unlink(id);
+    shapes[id].pts.clear();
+    freeIds.push_back(id);
+    --liveCount;
+}
+
+void Scene::moveBy(int id, int dx, int dy) {
+    if (!get(id) || (dx == 0 && dy == 0)) return;
+    Shape& s = shapes[id];
+    s.x += dx;
+    s.y += dy;
+    for (POINT& p : s.pts) { p.x += dx; p.y += dy; }
+    s.bounds.left += dx; s.bounds.right  += dx;
+    s.bounds.top  += dy; s.bounds.bottom += dy;
+
+    // Stay in the same node while the center is still inside its cell
+    const Node& n = nodes[s.node];
+    int cx = (s.bounds.left + s.bounds.right) / 2;
+    int cy = (s.bounds.top + s.bounds.bottom) / 2;
+    bool inCell = cx >= n.x && cy >= n.y && cx < n.x + n.size && cy < n.y + n.size;
+    if (s.node == 0 || !inCell) {
+        unlink(id);
+        insert(id);
+    }
+}
+
+void Scene::moveTo(int id, int x, int y) {
+    if (!get(id)) return;
+    moveBy(id, x - shapes[id].x, y - shapes[id].y);
+}
+
+void Scene::setColor(int id, color c) {
+    if (get(id)) shapes[id].c = c;
+}
+
+void Scene::clear() {
+    nodes.resize(1);
+    nodes[0].child = -1;
+    nodes[0].items.clear();
+    shapes.clear();
+    freeIds.clear();
+    liveCount = 0;
+    nextZ = 0;
+}
+
+void Scene::query(const RECT& area, std::vector<int>& out) const {
+    int stack[64 * 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& n = nodes[stack[--top]];
+        for (int id : n.items) {
+            const RECT& b = shapes[id].bounds;
+            if (b.right > area.left && b.bottom > area.top && b.left < area.right && b.top < area.bottom) {
+                out.push_back(id);
+            }
+        }
+        if (n.child < 0) continue;
+        for (int q = 0; q < 4; ++q) {
+            const Node& c = nodes[n.child + q];
+            int loose = c.size / 2;
+            if (c.x + c.size + loose > area.left && c.y + c.size + loose > area.top &&
+                c.x - loose < area.right && c.y - loose < area.bottom) {
+                stack[top++] = n.child + q;
+            }
+        }
+    }
+}
+
+void Scene::draw(Window& win, int camX, int camY) {
+    const RECT& clip = win.getClipRect();
+    RECT view = { clip.left + camX, clip.top + camY, clip.right + camX, clip.bottom + camY };
+    visible.clear();
+    query(view, visible);
+    std::sort(visible.begin(), visible.end(),
+              [this](int a, int b) { return shapes[a].z < shapes[b].z; });
+
+    std::vector<POINT> moved;
+    for (int id : visible) {
+        const Shape& s = shapes[id];
+        switch (s.type) {
+            case ShapeType::Rect:    win.writeRect(s.x - camX, s.y - camY, s.w, s.h, s.c); break;
+            case ShapeType::Circle:  win.writeCircle(s.x - camX, s.y - camY, s.w, s.c); break;
+            case ShapeType::Ellipse: win.writeEllipse(s.x - camX, s.y - camY, s.w, s.h, s.c); break;
+            case ShapeType::Polygon:
+                moved.resize(s.pts.size());
+                for (size_t i = 0; i < s.pts.size(); ++i) {
+                    moved[i] = { s.pts[i].x - camX, s.pts[i].y - camY };
+                }
+                win.writePolygon(moved, s.c);
+                break;
+        }
+    }
+}
+
+bool Scene::containsPoint(const Shape& s, int px, int py) {
+    if (px < s.bounds.left || py < s.bounds.top || px >= s.bounds.right || py >= s.bounds.bottom) return false;
+    switch (s.type) {
+        case ShapeType::Rect:
+            return true;
+        case ShapeType::Circle: {
+            long dx = px - s.x, dy = py - s.y;
+            return dx * dx + dy * dy <= (long)s.w * s.w;
+        }
+        case ShapeType::Ellipse: {
+            if (s.w == 0 || s.h == 0) return false;
+            float dx = float(px - s.x) / s.w, dy = float(py - s.y) / s.h;
+            return dx * dx + dy * dy <= 1.0f;
+        }
+        case ShapeType::Polygon: {
+            // Even-odd crossing test at the pixel center
+            bool inside = false;
+            float x = px + 0.5f, y = py + 0.5f;
+            size_t n = s.pts.size();
+            for (size_t i = 0, j = n - 1; i < n; j = i++) {
+                float xi = s.pts[i].x, yi = s.pts[i].y, xj = s.pts[j].x, yj = s.pts[j].y;
+                if ((yi > y) != (yj > y) && x < xi + (y - yi) * (xj - xi) / (yj - yi)) inside = !inside;
+            }
+            return inside;
+        }
+    }
+    return false;
+}
+
+int Scene::hitTest(int x, int y) const {
+    int best = -1;
+    uint32_t bestZ = 0;
+    int stack[64 * 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& n = nodes[stack[--top]];
+        for (int id : n.items) {
+            const Shape& s = shapes[id];
+            if ((best < 0 || s.z > bestZ) && containsPoint(s, x, y)) {
+                best = id;
+                bestZ = s.z;
+            }
+        }
+        if (n.child < 0) continue;
+        for (int q = 0; q < 4; ++q) {
+            const Node& c = nodes[n.child + q];
+            int loose = c.size / 2;
+            if (x >= c.x - loose && y >= c.y - loose && x < c.x + c.size + loose && y < c.y + c.size + loose) {
+                stack[top++] = n.child + q;
+            }
+        }
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "Window.h"
+
+enum class ShapeType { Rect, Circle, Ellipse, Polygon };
+
+struct Shape {
+    ShapeType type;
+    color c;
+    int x, y;     // Rect: top-left, Circle/Ellipse: center
+    int w, h;     // Rect: size, Circle: radius in w, Ellipse: radii
+    std::vector<POINT> pts; // Polygon
+    RECT bounds;  // world space, exclusive right/bottom
+    uint32_t z;   // draw order, later shapes on top
+    int node;     // quadtree node holding the shape, -1 if free
+};
+
+// Retained shapes in world coordinates, indexed by a loose quadtree so drawing
+// and hit testing only look at shapes near the area of interest. Shapes are
+// referred to by id; ids of removed shapes are reused.
+class Scene {
+    public:
+        // The tree covers (x, y, size, size); shapes outside it still work but sit in the root
+        Scene(int x, int y, int size, int maxDepth = 8);
+
+        int addRect(int x, int y, int w, int h, color c);
+        int addCircle(int cx, int cy, int radius, color c);
+        int addEllipse(int cx, int cy, int rx, int ry, color c);
+        int addPolygon(const std::vector<POINT>& pts, color c);
+        void remove(int id);
+        void moveBy(int id, int dx, int dy);
+        void moveTo(int id, int x, int y); // new top-left / center
+        void setColor(int id, color c);
+        void clear();
+
+        // Draw shapes overlapping the window clip rect, viewed from (camX, camY)
+        void draw(Window& win, int camX, int camY);
+        // Topmost shape containing the world point, or -1
+        int hitTest(int x, int y) const;
+        // Ids of shapes whose bounds overlap area (world space), unsorted
+        void query(const RECT& area, std::vector<int>& out) const;
+
+        inline const Shape* get(int id) const {
+            return (id >= 0 && id < (int)shapes.size() && shapes[id].node >= 0) ? &shapes[id] : nullptr;
+        }
+        inline int size() const { return liveCount; }
+
+    private:
+        struct Node {
+            int x, y, size;
+            int child = -1;   // index of the first of 4 children
+            std::vector<int> items;
+        };
+
+        int allocShape();
+        void updateBounds(Shape& s);
+        void insert(int id);
+        void unlink(int id);
+        static bool containsPoint(const Shape& s, int px, int py);
+
+        std::vector<Node> nodes;
+        std::vector<Shape> shapes;
+        std::vector<int> freeIds;
+        std::vector<int> visible; // scratch for draw()
+        int maxDepth;
+        int liveCount = 0;
+        uint32_t nextZ = 0;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef TEXTBLOCK_CPP
+#define TEXTBLOCK_CPP
+
+#include "TextBlock.h"
+
+TextBlock::TextBlock(const WCHAR* text, int scale, int lineSpacing)
+    : text(text), scale(fastMax(1, scale))
+{
+    // Lines may overlap but never step backwards
+    this->lineSpacing = fastMax(-8 * this->scale, lineSpacing);
+}
+
+bool TextBlock::setText(const WCHAR* newText) {
+    if (text == newText) return false;
+    text = newText;
+    dirty = true;
+    return true;
+}
+
+void TextBlock::setStyle(int newScale, int newLineSpacing) {
+    newScale = fastMax(1, newScale);
+    newLineSpacing = fastMax(-8 * newScale, newLineSpacing);
+    if (newScale == scale && newLineSpacing == lineSpacing) return;
+    scale = newScale;
+    lineSpacing = newLineSpacing;
+    dirty = true;
+}
+
+void TextBlock::layout() {
+    Window::measureText(text.c_str(), width, height, scale, lineSpacing);
+    mask.assign((size_t)width * height, 0);
+
+    int cursorX = 0, cursorY = 0;
+    for (WCHAR ch : text) {
+        if (ch == L'\n') {
+            cursorX = 0;
+            cursorY += 8 * scale + lineSpacing;
+            continue;
+        }
+        if (ch <= 127) {
+            for (int row = 0; row < 8; ++row) {
+                uint8_t bits = font8x8_basic[ch][row];
+                if (!bits) continue;
+                uint8_t* dst = mask.data() + (cursorY + row * scale) * width + cursorX;
+                for (int col = 0; col < 8; ++col) {
+                    if (bits & (1 << col)) memset(dst + col * scale, 0xFF, scale);
+                }
+                // Repeat the row for vertical scaling
+                for (int s = 1; s < scale; ++s) {
+                    memcpy(dst + s * width, dst, 8 * scale);
+                }
+            }
+        }
+        cursorX += 8 * scale;
+    }
+    dirty = false;
+}
+
+void TextBlock::draw(Window& win, int x, int y, color c) {
+    if (dirty) layout();
+    if (width == 0 || height == 0) return;
+    win.writeMask(mask.data(), width, height, x, y, c);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef TEXTBLOCK_H
+#define TEXTBLOCK_H
+
+#include "Window.h"
+#include <string>
+
+// A string laid out once into a cached glyph mask. Drawing is a single masked
+// blit; the layout is only redone when the text or style actually changes.
+// Color is applied at draw time so it is not part of the cache key.
+class TextBlock {
+    public:
+        TextBlock(const WCHAR* text = L"", int scale = 1, int lineSpacing = 0);
+
+        bool setText(const WCHAR* text); // returns true if the text changed
+        void setStyle(int scale, int lineSpacing);
+        void draw(Window& win, int x, int y, color c);
+
+        inline const std::wstring& getText() const { return text; }
+        inline int getWidth()  { if (dirty) layout(); return width; }
+        inline int getHeight() { if (dirty) layout(); return height; }
+
+    private:
+        void layout();
+
+        std::wstring text;
+        int scale;
+        int lineSpacing;
+        bool dirty = true;
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> mask; // width x height, 0 or 0xFF
+};
+
+#endif
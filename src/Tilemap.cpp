@@ -0,0 +1,101 @@
+#ifndef TILEMAP_CPP
+#define TILEMAP_CPP
+
+#include "Tilemap.h"
+
+Tilemap::Tilemap(const uint32_t* tileset, int tilesetW, int tilesetH,
+                 int tileSize, int mapW, int mapH, int chunkSize)
+    : tileset(tileset), tilesetW(tilesetW), tilesetH(tilesetH),
+      tileSize(tileSize), mapW(mapW), mapH(mapH)
+{
+    tilesPerRow = tilesetW / tileSize;
+    tileCount   = tilesPerRow * (tilesetH / tileSize);
+    chunkTiles  = fastMax(1, chunkSize / tileSize);
+    chunksX = (mapW + chunkTiles - 1) / chunkTiles;
+    chunksY = (mapH + chunkTiles - 1) / chunkTiles;
+
+    tiles.assign((size_t)mapW * mapH, -1);
+    chunks.resize((size_t)chunksX * chunksY);
+    for (int cy = 0; cy < chunksY; ++cy) {
+        for (int cx = 0; cx < chunksX; ++cx) {
+            Chunk& ch = chunks[cy * chunksX + cx];
+            ch.w = (std::min(mapW, (cx + 1) * chunkTiles) - cx * chunkTiles) * tileSize;
+            ch.h = (std::min(mapH, (cy + 1) * chunkTiles) - cy * chunkTiles) * tileSize;
+        }
+    }
+}
+
+void Tilemap::setTile(int tx, int ty, int index) {
+    if ((unsigned)tx >= (unsigned)mapW || (unsigned)ty >= (unsigned)mapH) return;
+    int& t = tiles[ty * mapW + tx];
+    if (t == index) return;
+    t = index;
+    chunks[(ty / chunkTiles) * chunksX + (tx / chunkTiles)].dirty = true;
+}
+
+void Tilemap::fill(int index) {
+    std::fill(tiles.begin(), tiles.end(), index);
+    invalidate();
+}
+
+void Tilemap::invalidate() {
+    for (auto& ch : chunks) ch.dirty = true;
+}
+
+void Tilemap::rasterizeChunk(int cx, int cy) {
+    Chunk& ch = chunks[cy * chunksX + cx];
+    if (ch.pixels.empty()) ch.pixels.resize((size_t)ch.w * ch.h);
+
+    int tx0 = cx * chunkTiles;
+    int ty0 = cy * chunkTiles;
+    int tilesW = ch.w / tileSize;
+    int tilesH = ch.h / tileSize;
+    size_t rowBytes = tileSize * sizeof(uint32_t);
+
+    for (int ty = 0; ty < tilesH; ++ty) {
+        for (int tx = 0; tx < tilesW; ++tx) {
+            int index = tiles[(ty0 + ty) * mapW + (tx0 + tx)];
+            uint32_t* dst = ch.pixels.data() + (ty * tileSize) * ch.w + tx * tileSize;
+            if (index < 0 || index >= tileCount) {
+                for (int row = 0; row < tileSize; ++row) {
+                    std::fill(dst + row * ch.w, dst + row * ch.w + tileSize, emptyColor);
+                }
+                continue;
+            }
+            const uint32_t* src = tileset
+                + (index / tilesPerRow) * tileSize * tilesetW
+                + (index % tilesPerRow) * tileSize;
+            for (int row = 0; row < tileSize; ++row) {
+                memcpy(dst + row * ch.w, src + row * tilesetW, rowBytes);
+            }
+        }
+    }
+    ch.dirty = false;
+}
+
+void Tilemap::draw(Window& win, int camX, int camY) {
+    // Only chunks overlapping the clip rect (in map space) are visible
+    const RECT& clip = win.getClipRect();
+    int chunkPx = chunkTiles * tileSize;
+    int left   = clip.left   + camX;
+    int top    = clip.top    + camY;
+    int right  = clip.right  + camX;
+    int bottom = clip.bottom + camY;
+    if (right <= 0 || bottom <= 0 || left >= getPixelWidth() || top >= getPixelHeight()) return;
+
+    int cx0 = fastMax(0, left / chunkPx);
+    int cy0 = fastMax(0, top / chunkPx);
+    int cx1 = fastMin(chunksX - 1, (right - 1) / chunkPx);
+    int cy1 = fastMin(chunksY - 1, (bottom - 1) / chunkPx);
+
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            Chunk& ch = chunks[cy * chunksX + cx];
+            if (ch.dirty) rasterizeChunk(cx, cy);
+            win.writeAlphaBitmap(ch.pixels.data(), ch.w, ch.h,
+                                 cx * chunkPx - camX, cy * chunkPx - camY, 255);
+        }
+    }
+}
+
+#endif
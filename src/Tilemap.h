@@ -0,0 +1,53 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include "Window.h"
+
+// Tile map drawn from cached, pre-rasterized chunks. Tiles are stored as
+// indices into a tileset image; each chunk (chunkSize x chunkSize pixels) is
+// rasterized once and then blitted with the opaque copy path until one of its
+// tiles changes. Only chunks overlapping the current clip rect are touched.
+class Tilemap {
+    public:
+        // tileset is top-down 0x00BBGGRR, tiles laid out left to right, top to bottom
+        Tilemap(const uint32_t* tileset, int tilesetW, int tilesetH,
+                int tileSize, int mapW, int mapH, int chunkSize = 256);
+
+        void setTile(int tx, int ty, int index);
+        void fill(int index);
+        void invalidate(); // e.g. after changing the tileset pixels
+        void draw(Window& win, int camX, int camY);
+
+        inline int getTile(int tx, int ty) const {
+            if ((unsigned)tx >= (unsigned)mapW || (unsigned)ty >= (unsigned)mapH) return -1;
+            return tiles[ty * mapW + tx];
+        }
+        inline int getMapWidth() const { return mapW; }
+        inline int getMapHeight() const { return mapH; }
+        inline int getTileSize() const { return tileSize; }
+        inline int getPixelWidth() const { return mapW * tileSize; }
+        inline int getPixelHeight() const { return mapH * tileSize; }
+        inline void setEmptyColor(color c) { emptyColor = (c.r) | (c.g << 8) | (c.b << 16); invalidate(); }
+
+    private:
+        struct Chunk {
+            std::vector<uint32_t> pixels; // allocated on first use
+            int w = 0, h = 0;
+            bool dirty = true;
+        };
+
+        void rasterizeChunk(int cx, int cy);
+
+        const uint32_t* tileset;
+        int tilesetW, tilesetH;
+        int tilesPerRow, tileCount;
+        int tileSize;
+        int mapW, mapH;
+        int chunkTiles;  // tiles per chunk side
+        int chunksX, chunksY;
+        uint32_t emptyColor = 0;
+        std::vector<int> tiles;
+        std::vector<Chunk> chunks;
+};
+
+#endif
@@ -50,55 +50,140 @@ Window::~Window() {
 
 }
 
+// Fill len pixels starting at dst with a solid color
+static inline void fillSpan(uint32_t* dst, int len, uint32_t packed) {
+    __m128i fill = _mm_set1_epi32(packed);
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        _mm_storeu_si128((__m128i*)&dst[i], fill);
+    }
+    for (; i < len; ++i) {
+        dst[i] = packed;
+    }
+}
+
+// Fill the inclusive span [xL, xR] on row y, clipped to the clip rect
+inline void Window::fillClippedSpan(int y, int xL, int xR, uint32_t packed) {
+    if (y < clipRect.top || y >= clipRect.bottom) return;
+    if (xL < clipRect.left)      xL = clipRect.left;
+    if (xR >= clipRect.right)    xR = clipRect.right - 1;
+    if (xL > xR) return;
+    // Only the tiles this span actually crosses need their clear
+    if (pendingClears) resolveClearTiles(xL, y, xR + 1, y + 1, false);
+    fillSpan(static_cast<uint32_t*>(pixelBuffer) + y * bufferStride + xL, xR - xL + 1, packed);
+}
+
 void Window::writeBackground(color c) {
     uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
     uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
-    size_t count = bufferWidth * bufferHeight;
 
-    __m128i fill = _mm_set1_epi32(packed);
-    size_t i = 0;
-    for (; i + 4 <= count; i += 4) {
-        _mm_storeu_si128((__m128i*)&pixels[i], fill);
+    if (clipRect.left != 0 || clipRect.top != 0 ||
+        clipRect.right != bufferWidth || clipRect.bottom != bufferHeight) {
+        // Only clear the current clip region
+        coverClear(clipRect.left, clipRect.top, clipRect.right, clipRect.bottom);
+        for (int row = clipRect.top; row < clipRect.bottom; ++row) {
+            fillSpan(pixels + row * bufferStride + clipRect.left, clipRect.right - clipRect.left, packed);
+        }
+        markDirty(clipRect.left, clipRect.top, clipRect.right - clipRect.left, clipRect.bottom - clipRect.top);
+        return;
     }
-    for (; i < count; ++i) {
-        pixels[i] = packed;
+
+    if (useLazyClear) {
+        // Just record it, tiles are cleared when first touched or at present()
+        clearColor = packed;
+        clearTilesX = (bufferWidth  + clearTileSize - 1) / clearTileSize;
+        clearTilesY = (bufferHeight + clearTileSize - 1) / clearTileSize;
+        pendingClears = clearTilesX * clearTilesY;
+        clearTiles.assign(pendingClears, 1);
+    } else {
+        pendingClears = 0; // nothing left to restore either
+        if (bufferStride == bufferWidth) {
+            fillSpan(pixels, bufferWidth * bufferHeight, packed);
+        } else {
+            for (int row = 0; row < bufferHeight; ++row) {
+                fillSpan(pixels + row * bufferStride, bufferWidth, packed);
+            }
+        }
     }
     markDirty(0, 0, bufferWidth, bufferHeight);
     isAllDirty = true;
 }
 
 void Window::writePoint(int x, int y, color c) {
-    if ((unsigned)x >= (unsigned)bufferWidth || (unsigned)y >= (unsigned)bufferHeight) return;
+    if (x < clipRect.left || x >= clipRect.right || y < clipRect.top || y >= clipRect.bottom) return;
+    resolveClear(x, y, x + 1, y + 1);
     uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
-    pixels[y * bufferWidth + x] = (c.r) | (c.g << 8) | (c.b << 16); // 0x00BBGGR
+    pixels[y * bufferStride + x] = (c.r) | (c.g << 8) | (c.b << 16); // 0x00BBGGR
     markDirty(x, y, 1, 1);
 }
 
-void Window::writeLine(int x1, int y1, int x2, int y2, color c) {
-    uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
-    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+static inline int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
 
+static inline int64_t ceilDiv(int64_t a, int64_t b) {
+    return -floorDiv(-a, b);
+}
+
+void Window::writeLine(int x1, int y1, int x2, int y2, color c) {
+    int left   = fastMin(x1, x2);
+    int top    = fastMin(y1, y2);
+    int right  = fastMax(x1, x2);
+    int bottom = fastMax(y1, y2);
+    if (clipReject(left, top, right + 1, bottom + 1)) return;
+
+    // Clip in integer space. Along the major axis every Bresenham step moves by
+    // one pixel and the minor coordinate after j steps is
+    // floor((2*j*dMinor + dMajor) / (2*dMajor)), so the visible step range can be
+    // solved for directly and the loop entered with the exact error term it
+    // would have had, keeping the clipped pixels identical to the full line
     int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
     int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
-    int err = dx + dy;
+    bool xMajor = dx >= -dy;
+    int64_t dMaj = xMajor ? dx : -dy, dMin = xMajor ? -dy : dx;
+    int aStart = xMajor ? x1 : y1, aStep = xMajor ? sx : sy;
+    int bStart = xMajor ? y1 : x1, bStep = xMajor ? sy : sx;
+    int aLo = xMajor ? clipRect.left : clipRect.top, aHi = (xMajor ? clipRect.right : clipRect.bottom) - 1;
+    int bLo = xMajor ? clipRect.top : clipRect.left, bHi = (xMajor ? clipRect.bottom : clipRect.right) - 1;
+
+    // Visible range in steps from the start point, measured along each step direction
+    int64_t aMin = aStep > 0 ? aLo - aStart : aStart - aHi;
+    int64_t aMax = aStep > 0 ? aHi - aStart : aStart - aLo;
+    int64_t bMin = bStep > 0 ? bLo - bStart : bStart - bHi;
+    int64_t bMax = bStep > 0 ? bHi - bStart : bStart - bLo;
+
+    int64_t j0 = std::max<int64_t>(0, aMin);
+    int64_t j1 = std::min<int64_t>(dMaj, aMax);
+    if (dMin == 0) {
+        if (bMin > 0 || bMax < 0) return;
+    } else {
+        // minor(j) >= bMin  <=>  2*j*dMin >= (2*bMin - 1) * dMaj
+        j0 = std::max(j0, ceilDiv((2 * bMin - 1) * dMaj, 2 * dMin));
+        // minor(j) <= bMax  <=>  2*j*dMin < (2*bMax + 1) * dMaj
+        j1 = std::min(j1, floorDiv((2 * bMax + 1) * dMaj - 1, 2 * dMin));
+    }
+    if (j0 > j1) return;
+
+    int64_t m0 = dMaj ? floorDiv(2 * j0 * dMin + dMaj, 2 * dMaj) : 0;
+    int64_t xSteps = xMajor ? j0 : m0, ySteps = xMajor ? m0 : j0;
+    int cx = x1 + (int)xSteps * sx, cy = y1 + (int)ySteps * sy;
+    int64_t err = dx + dy + xSteps * dy + ySteps * dx;
+    int64_t steps = j1 - j0;
+
+    uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
 
     while (true) {
-        if ((unsigned)x1 < (unsigned)bufferWidth && (unsigned)y1 < (unsigned)bufferHeight) {
-            pixels[y1 * bufferWidth + x1] = packed;
-        }
-        if (x1 == x2 && y1 == y2) break;
-        int e2 = 2 * err;
-        if (e2 >= dy) { err += dy; x1 += sx; }
-        if (e2 <= dx) { err += dx; y1 += sy; }
+        resolveClearAt(cx, cy);
+        pixels[cy * bufferStride + cx] = packed;
+        if (steps-- == 0) break;
+        int64_t e2 = 2 * err;
+        if (e2 >= dy) { err += dy; cx += sx; }
+        if (e2 <= dx) { err += dx; cy += sy; }
     }
 
-    if (useMarkDirty) {
-        int left   = fastMin(x1, x2);
-        int top    = fastMin(y1, y2);
-        int right  = fastMax(x1, x2);
-        int bottom = fastMax(y1, y2);
-        markDirty(left, top, right - left + 1, bottom - top + 1);
-    }
+    markDirty(left, top, right - left + 1, bottom - top + 1);
 }
 
 void Window::writeSquare(int x, int y, int scale, color c) {
@@ -106,36 +191,37 @@ void Window::writeSquare(int x, int y, int scale, color c) {
 }
 
 void Window::writeRect(int x, int y, int w, int h, color c) {
-    int startX = fastMax(0, x);
-    int startY = fastMax(0, y);
-    int endX   = fastMin(bufferWidth,  x + w);
-    int endY   = fastMin(bufferHeight, y + h);
+    int startX = fastMax((int)clipRect.left, x);
+    int startY = fastMax((int)clipRect.top, y);
+    int endX   = fastMin((int)clipRect.right,  x + w);
+    int endY   = fastMin((int)clipRect.bottom, y + h);
     if (startX >= endX || startY >= endY) return;
+    coverClear(startX, startY, endX, endY);
 
     uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
-    __m128i fill = _mm_set1_epi32(packed);
-
     uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
     for (int row = startY; row < endY; ++row) {
-        uint32_t* dst = pixels + row * bufferWidth + startX;
-        int len = endX - startX;
-        int i = 0;
-        for (; i + 4 <= len; i += 4) {
-            _mm_storeu_si128((__m128i*)&dst[i], fill);
-        }
-        for (; i < len; ++i) {
-            dst[i] = packed;
-        }
+        fillSpan(pixels + row * bufferStride + startX, endX - startX, packed);
     }
-    markDirty(x, y, w, h);
+    markDirty(startX, startY, endX - startX, endY - startY);
 }
 
 struct Edge { int yMin, yMax, x; float invSlope; };
 
 void Window::writePolygon(const std::vector<POINT>& pts, color c) {
     if (pts.size() < 3) return;
+
+    int minX = pts[0].x, maxX = pts[0].x;
+    int minY = pts[0].y, maxY = pts[0].y;
+    for (size_t i = 1; i < pts.size(); ++i) {
+        minX = fastMin((long)minX, pts[i].x);
+        maxX = fastMax((long)maxX, pts[i].x);
+        minY = fastMin((long)minY, pts[i].y);
+        maxY = fastMax((long)maxY, pts[i].y);
+    }
+    if (clipReject(minX, minY, maxX + 1, maxY + 1)) return;
+
     uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
-    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
 
     // Build edge table
     std::vector<Edge> edges;
@@ -152,15 +238,12 @@ void Window::writePolygon(const std::vector<POINT>& pts, color c) {
         edges.push_back(e);
     }
 
-    int yMin = INT_MAX, yMax = INT_MIN;
-    for (auto& e : edges) {
-        yMin = fastMin(yMin, e.yMin);
-        yMax = fastMax(yMax, e.yMax);
-    }
-
-    // Scanline fill
-    for (int y = yMin; y < yMax; ++y) {
-        std::vector<int> xInts;
+    // Scanline fill, only over rows inside the clip rect
+    int yStart = fastMax(minY, (int)clipRect.top);
+    int yEnd   = fastMin(maxY, (int)clipRect.bottom);
+    std::vector<int> xInts;
+    for (int y = yStart; y < yEnd; ++y) {
+        xInts.clear();
         for (auto& e : edges) {
             if (y >= e.yMin && y < e.yMax) {
                 xInts.push_back(int(e.x + (y - e.yMin) * e.invSlope));
@@ -168,29 +251,16 @@ void Window::writePolygon(const std::vector<POINT>& pts, color c) {
         }
         std::sort(xInts.begin(), xInts.end());
         for (size_t i = 0; i+1 < xInts.size(); i += 2) {
-            int xL = fastMax(0, xInts[i]);
-            int xR = fastMin(bufferWidth-1, xInts[i+1]);
-            if (y >= 0 && y < bufferHeight) {
-                for (int x = xL; x <= xR; ++x) {
-                    pixels[y * bufferWidth + x] = packed;
-                }
-            }
+            fillClippedSpan(y, xInts[i], xInts[i+1], packed);
         }
     }
 
-    int minX = pts[0].x, maxX = pts[0].x;
-    int minY = pts[0].y, maxY = pts[0].y;
-    for (int i = 1; i < pts.size(); ++i) {
-        minX = fastMin((long)minX, pts[i].x);
-        maxX = fastMax((long)maxX, pts[i].x);
-        minY = fastMin((long)minY, pts[i].y);
-        maxY = fastMax((long)maxY, pts[i].y);
-    }
     markDirty(minX, minY, maxX - minX + 1, maxY - minY + 1);
 }
 
 inline void Window::plotAA(int x, int y, float c, uint32_t packed) {
-    if ((unsigned)x >= (unsigned)bufferWidth || (unsigned)y >= (unsigned)bufferHeight) return;
+    if (x < clipRect.left || x >= clipRect.right || y < clipRect.top || y >= clipRect.bottom) return;
+    resolveClearAt(x, y);
 
     uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
 
@@ -199,7 +269,7 @@ inline void Window::plotAA(int x, int y, float c, uint32_t packed) {
     uint8_t sg = (packed >> 8) & 0xFF;
     uint8_t sb = (packed >> 16) & 0xFF;
 
-    uint32_t dst = pixels[y * bufferWidth + x];
+    uint32_t dst = pixels[y * bufferStride + x];
     uint8_t dr = dst & 0xFF;
     uint8_t dg = (dst >> 8) & 0xFF;
     uint8_t db = (dst >> 16) & 0xFF;
@@ -208,28 +278,31 @@ inline void Window::plotAA(int x, int y, float c, uint32_t packed) {
     uint8_t ng = uint8_t(sg * c + dg * (1 - c));
     uint8_t nb = uint8_t(sb * c + db * (1 - c));
 
-    pixels[y * bufferWidth + x] = nr | (ng << 8) | (nb << 16);
+    pixels[y * bufferStride + x] = nr | (ng << 8) | (nb << 16);
 }
 
 void Window::writeCircle(int cx, int cy, int radius, color col) {
+    // The AA edge reaches one pixel past the radius
+    if (clipReject(cx - radius - 1, cy - radius - 1, cx + radius + 2, cy + radius + 2)) return;
+    // The inscribed square is filled solid; spans and edge pixels settle the rest as they go
+    int inner = (int)(radius * 0.7071f) - 1;
+    if (inner > 0) coverClear(cx - inner, cy - inner, cx + inner + 1, cy + inner + 1);
     uint32_t packed = (col.r) | (col.g << 8) | (col.b << 16);
-    auto* pixels = static_cast<uint32_t*>(pixelBuffer);
 
     // --- Step 1: fill interior with solid spans ---
-    for (int yy = -radius; yy <= radius; ++yy) {
-        int yAbs = cy + yy;
-        if (yAbs < 0 || yAbs >= bufferHeight) continue;
+    int yyStart = fastMax(-radius, (int)clipRect.top - cy);
+    int yyEnd   = fastMin(radius, (int)clipRect.bottom - 1 - cy);
+    for (int yy = yyStart; yy <= yyEnd; ++yy) {
         float dx = sqrtf((float)radius*radius - (float)yy*yy);
         int xL = (int)floorf(cx - dx);
         int xR = (int)ceilf (cx + dx);
-        if (xL < 0) xL = 0;
-        if (xR >= bufferWidth) xR = bufferWidth - 1;
-        for (int xx = xL; xx <= xR; ++xx)
-            pixels[yAbs * bufferWidth + xx] = packed;
+        fillClippedSpan(cy + yy, xL, xR, packed);
     }
 
     // --- Step 2: antialiased edge ---
-    for (int xx = -radius; xx <= radius; ++xx) {
+    int xxStart = fastMax(-radius, (int)clipRect.left - cx);
+    int xxEnd   = fastMin(radius, (int)clipRect.right - 1 - cx);
+    for (int xx = xxStart; xx <= xxEnd; ++xx) {
         float dy = sqrtf((float)radius*radius - (float)xx*xx);
         int yi = (int)floorf(dy);
         float f = dy - yi;
@@ -243,12 +316,14 @@ void Window::writeCircle(int cx, int cy, int radius, color col) {
         plotAA(cx + xx, cy - yi - 1, f, packed);
     }
 
-    markDirty(cx - radius, cy - radius, radius * 2, radius * 2);
+    markDirty(cx - radius - 1, cy - radius - 1, radius * 2 + 3, radius * 2 + 3);
 }
 
 void Window::writeEllipse(int cx, int cy, int rx, int ry, color c) {
+    if (clipReject(cx - rx, cy - ry, cx + rx + 1, cy + ry + 1)) return;
+    int innerX = (int)(rx * 0.7071f) - 1, innerY = (int)(ry * 0.7071f) - 1;
+    if (innerX > 0 && innerY > 0) coverClear(cx - innerX, cy - innerY, cx + innerX + 1, cy + innerY + 1);
     uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
-    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
 
     long rx2 = rx * rx;
     long ry2 = ry * ry;
@@ -264,15 +339,8 @@ void Window::writeEllipse(int cx, int cy, int rx, int ry, color c) {
     long p = round(ry2 - (rx2 * ry) + (0.25 * rx2));
     while (px < py) {
         // draw horizontal spans
-        int xL = cx - x, xR = cx + x;
-        if (y >= 0 && y < bufferHeight) {
-            if (xL < bufferWidth && xR >= 0) {
-                for (int xx = fastMax(0, xL); xx <= fastMin(bufferWidth-1, xR); ++xx) {
-                    pixels[(cy + y) * bufferWidth + xx] = packed;
-                    pixels[(cy - y) * bufferWidth + xx] = packed;
-                }
-            }
-        }
+        fillClippedSpan(cy + y, cx - x, cx + x, packed);
+        if (y != 0) fillClippedSpan(cy - y, cx - x, cx + x, packed);
         x++;
         px += twoRy2;
         if (p < 0) {
@@ -287,15 +355,8 @@ void Window::writeEllipse(int cx, int cy, int rx, int ry, color c) {
     // Region 2
     p = round(ry2 * (x + 0.5) * (x + 0.5) + rx2 * (y - 1) * (y - 1) - rx2 * ry2);
     while (y >= 0) {
-        int xL = cx - x, xR = cx + x;
-        if (y >= 0 && y < bufferHeight) {
-            if (xL < bufferWidth && xR >= 0) {
-                for (int xx = fastMax(0, xL); xx <= fastMin(bufferWidth-1, xR); ++xx) {
-                    pixels[(cy + y) * bufferWidth + xx] = packed;
-                    pixels[(cy - y) * bufferWidth + xx] = packed;
-                }
-            }
-        }
+        fillClippedSpan(cy + y, cx - x, cx + x, packed);
+        if (y != 0) fillClippedSpan(cy - y, cx - x, cx + x, packed);
         y--;
         py -= twoRx2;
         if (p > 0) {
@@ -306,25 +367,30 @@ void Window::writeEllipse(int cx, int cy, int rx, int ry, color c) {
             p += rx2 - py + px;
         }
     }
-    markDirty(x, y, rx, ry);
+    markDirty(cx - rx, cy - ry, rx * 2 + 1, ry * 2 + 1);
 }
 
 void Window::writeChar(int x, int y, WCHAR ch, color c) {
     if (ch > 127) return; // only ASCII supported
+    if (clipReject(x, y, x + 8, y + 8)) return;
+    resolveClear(x, y, x + 8, y + 8);
     uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
     uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
 
-    for (int row = 0; row < 8; ++row) {
-        uint8_t bits = font8x8_basic[ch][row];
-        for (int col = 0; col < 8; ++col) {
-            if (bits & (1 << col)) {
-                int px = x + col;
-                int py = y + row;
-                if ((unsigned)px < (unsigned)bufferWidth &&
-                    (unsigned)py < (unsigned)bufferHeight) {
-                    pixels[py * bufferWidth + px] = packed;
-                }
-            }
+    // Clip the glyph cell once, then mask off columns outside the clip rect
+    int rowStart = fastMax(0, (int)clipRect.top - y);
+    int rowEnd   = fastMin(8, (int)clipRect.bottom - y);
+    int colStart = fastMax(0, (int)clipRect.left - x);
+    int colEnd   = fastMin(8, (int)clipRect.right - x);
+    uint8_t colMask = (uint8_t)((0xFF << colStart) & (0xFF >> (8 - colEnd)));
+
+    for (int row = rowStart; row < rowEnd; ++row) {
+        uint8_t bits = font8x8_basic[ch][row] & colMask;
+        uint32_t* dst = pixels + (y + row) * bufferStride + x;
+        while (bits) {
+            int col = __builtin_ctz(bits);
+            dst[col] = packed;
+            bits &= bits - 1;
         }
     }
     markDirty(x, y, 8, 8);
@@ -338,6 +404,56 @@ void Window::writeText(int x, int y, const WCHAR* text, color c) {
     }
 }
 
+// Size of text as laid out by TextBlock: 8x8 glyphs, '\n' starts a new line
+void Window::measureText(const WCHAR* text, int& w, int& h, int scale, int lineSpacing) {
+    lineSpacing = fastMax(-8 * scale, lineSpacing);
+    int cols = 0, maxCols = 0, lines = 1;
+    for (const WCHAR* p = text; *p; ++p) {
+        if (*p == L'\n') { ++lines; cols = 0; continue; }
+        if (++cols > maxCols) maxCols = cols;
+    }
+    w = maxCols * 8 * scale;
+    h = maxCols ? lines * 8 * scale + (lines - 1) * lineSpacing : 0;
+}
+
+// Fill every pixel whose mask byte is non-zero with c. The mask is maskW x maskH,
+// one byte per pixel (0 or 0xFF).
+void Window::writeMask(const uint8_t* mask, int maskW, int maskH, int dstX, int dstY, color c) {
+    int startX = fastMax((int)clipRect.left, dstX);
+    int startY = fastMax((int)clipRect.top, dstY);
+    int endX   = fastMin((int)clipRect.right,  dstX + maskW);
+    int endY   = fastMin((int)clipRect.bottom, dstY + maskH);
+    if (startX >= endX || startY >= endY) return;
+    resolveClear(startX, startY, endX, endY);
+
+    uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
+    __m128i fill = _mm_set1_epi32(packed);
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    int count = endX - startX;
+
+    for (int y = startY; y < endY; ++y) {
+        uint32_t* dst = pixels + y * bufferStride + startX;
+        const uint8_t* m = mask + (y - dstY) * maskW + (startX - dstX);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32_t bits;
+            memcpy(&bits, m + i, 4);
+            if (bits == 0) continue;
+            // Widen each mask byte to a 32-bit lane
+            __m128i mk = _mm_cvtsi32_si128((int)bits);
+            mk = _mm_unpacklo_epi8(mk, mk);
+            mk = _mm_unpacklo_epi16(mk, mk);
+            __m128i d = _mm_loadu_si128((__m128i*)&dst[i]);
+            d = _mm_or_si128(_mm_and_si128(mk, fill), _mm_andnot_si128(mk, d));
+            _mm_storeu_si128((__m128i*)&dst[i], d);
+        }
+        for (; i < count; ++i) {
+            if (m[i]) dst[i] = packed;
+        }
+    }
+    markDirty(startX, startY, endX - startX, endY - startY);
+}
+
 inline uint32_t blendPixel(uint32_t dst, uint32_t src, uint8_t alpha) {
     uint32_t inv = 255 - alpha;
     uint8_t dr = dst & 0xFF, dg = (dst >> 8) & 0xFF, db = (dst >> 16) & 0xFF;
@@ -372,37 +488,242 @@ inline __m128i blend4_sse2(__m128i dst, __m128i src, __m128i alpha16) {
     return _mm_packus_epi16(lo, hi);
 }
 
+// --- Blend modes ---
+// Multiply/Screen use the exact (x + 128 + ((x + 128) >> 8)) >> 8 division by
+// 255 on 16-bit lanes; the others are single saturating byte instructions.
+
+static inline __m128i mulDiv255_sse2(__m128i a, __m128i b) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static inline __m128i multiply4_sse2(__m128i d, __m128i s) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = mulDiv255_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+    __m128i hi = mulDiv255_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+    return _mm_packus_epi16(lo, hi);
+}
+
+template <BlendMode M>
+static inline __m128i blendOp_sse2(__m128i d, __m128i s) {
+    switch (M) {
+        case BlendMode::Add:      return _mm_adds_epu8(d, s);
+        case BlendMode::Multiply: return multiply4_sse2(d, s);
+        case BlendMode::Screen: {
+            __m128i ones = _mm_set1_epi32(-1);
+            return _mm_xor_si128(multiply4_sse2(_mm_xor_si128(d, ones), _mm_xor_si128(s, ones)), ones);
+        }
+        case BlendMode::Darken:   return _mm_min_epu8(d, s);
+        case BlendMode::Lighten:  return _mm_max_epu8(d, s);
+    }
+    return d;
+}
+
+template <BlendMode M, bool Solid>
+static void blendSpan_sse2(uint32_t* dst, const uint32_t* src, int n) {
+    const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i solid = _mm_set1_epi32(Solid ? (int)src[0] : 0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = Solid ? solid : _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i d = _mm_loadu_si128((__m128i*)&dst[i]);
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_and_si128(blendOp_sse2<M>(d, s), rgbMask));
+    }
+    for (; i < n; ++i) {
+        __m128i s = _mm_cvtsi32_si128((int)(Solid ? src[0] : src[i]));
+        __m128i d = _mm_cvtsi32_si128((int)dst[i]);
+        dst[i] = (uint32_t)_mm_cvtsi128_si32(blendOp_sse2<M>(d, s)) & 0x00FFFFFF;
+    }
+}
+
+#define AVX2_FN __attribute__((target("avx2")))
+
+AVX2_FN static inline __m256i mulDiv255_avx2(__m256i a, __m256i b) {
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+AVX2_FN static inline __m256i multiply8_avx2(__m256i d, __m256i s) {
+    // unpack/pack work per 128-bit lane, so the pixel order is preserved
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = mulDiv255_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+    __m256i hi = mulDiv255_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+template <BlendMode M>
+AVX2_FN static inline __m256i blendOp_avx2(__m256i d, __m256i s) {
+    switch (M) {
+        case BlendMode::Add:      return _mm256_adds_epu8(d, s);
+        case BlendMode::Multiply: return multiply8_avx2(d, s);
+        case BlendMode::Screen: {
+            __m256i ones = _mm256_set1_epi32(-1);
+            return _mm256_xor_si256(multiply8_avx2(_mm256_xor_si256(d, ones), _mm256_xor_si256(s, ones)), ones);
+        }
+        case BlendMode::Darken:   return _mm256_min_epu8(d, s);
+        case BlendMode::Lighten:  return _mm256_max_epu8(d, s);
+    }
+    return d;
+}
+
+template <BlendMode M, bool Solid>
+AVX2_FN static void blendSpan_avx2(uint32_t* dst, const uint32_t* src, int n) {
+    const __m256i rgbMask = _mm256_set1_epi32(0x00FFFFFF);
+    __m256i solid = _mm256_set1_epi32(Solid ? (int)src[0] : 0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = Solid ? solid : _mm256_loadu_si256((const __m256i*)&src[i]);
+        __m256i d = _mm256_loadu_si256((__m256i*)&dst[i]);
+        _mm256_storeu_si256((__m256i*)&dst[i], _mm256_and_si256(blendOp_avx2<M>(d, s), rgbMask));
+    }
+    // Remaining < 8 pixels
+    blendSpan_sse2<M, Solid>(dst + i, Solid ? src : src + i, n - i);
+}
+
+typedef void (*BlendSpanFn)(uint32_t*, const uint32_t*, int);
+
+template <bool Solid>
+static BlendSpanFn pickBlendSpan(BlendMode mode) {
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    switch (mode) {
+        case BlendMode::Add:      return hasAVX2 ? blendSpan_avx2<BlendMode::Add, Solid>      : blendSpan_sse2<BlendMode::Add, Solid>;
+        case BlendMode::Multiply: return hasAVX2 ? blendSpan_avx2<BlendMode::Multiply, Solid> : blendSpan_sse2<BlendMode::Multiply, Solid>;
+        case BlendMode::Screen:   return hasAVX2 ? blendSpan_avx2<BlendMode::Screen, Solid>   : blendSpan_sse2<BlendMode::Screen, Solid>;
+        case BlendMode::Darken:   return hasAVX2 ? blendSpan_avx2<BlendMode::Darken, Solid>   : blendSpan_sse2<BlendMode::Darken, Solid>;
+        case BlendMode::Lighten:  return hasAVX2 ? blendSpan_avx2<BlendMode::Lighten, Solid>  : blendSpan_sse2<BlendMode::Lighten, Solid>;
+    }
+    return blendSpan_sse2<BlendMode::Add, Solid>;
+}
+
+void blendSpan(uint32_t* dst, const uint32_t* src, int n, BlendMode mode) {
+    if (n > 0) pickBlendSpan<false>(mode)(dst, src, n);
+}
+
+void blendSpanSolid(uint32_t* dst, uint32_t src, int n, BlendMode mode) {
+    if (n > 0) pickBlendSpan<true>(mode)(dst, &src, n);
+}
+
+void Window::writeRectBlend(int x, int y, int w, int h, color c, BlendMode mode) {
+    int startX = fastMax((int)clipRect.left, x);
+    int startY = fastMax((int)clipRect.top, y);
+    int endX   = fastMin((int)clipRect.right,  x + w);
+    int endY   = fastMin((int)clipRect.bottom, y + h);
+    if (startX >= endX || startY >= endY) return;
+    resolveClear(startX, startY, endX, endY);
+
+    uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
+    BlendSpanFn fn = pickBlendSpan<true>(mode);
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    for (int row = startY; row < endY; ++row) {
+        fn(pixels + row * bufferStride + startX, &packed, endX - startX);
+    }
+    markDirty(startX, startY, endX - startX, endY - startY);
+}
+
+void Window::writeBitmapBlend(const uint32_t* srcPixels, int srcW, int srcH,
+                              int dstX, int dstY, BlendMode mode) {
+    int startX = fastMax((int)clipRect.left, dstX);
+    int startY = fastMax((int)clipRect.top, dstY);
+    int endX   = fastMin((int)clipRect.right,  dstX + srcW);
+    int endY   = fastMin((int)clipRect.bottom, dstY + srcH);
+    if (startX >= endX || startY >= endY) return;
+    resolveClear(startX, startY, endX, endY);
+
+    BlendSpanFn fn = pickBlendSpan<false>(mode);
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    for (int y = startY; y < endY; ++y) {
+        fn(pixels + y * bufferStride + startX,
+           srcPixels + (y - dstY) * srcW + (startX - dstX), endX - startX);
+    }
+    markDirty(startX, startY, endX - startX, endY - startY);
+}
+
+template <BlendMode M>
+static void blendPoints_sse2(uint32_t* pixels, const int* idx, size_t n, uint32_t packed) {
+    __m128i s = _mm_set1_epi32((int)packed);
+    size_t i = 0;
+    // Gather 4 pixels, blend, scatter. Batches that hit the same pixel twice
+    // fall through to the sequential loop so every particle is accumulated.
+    for (; i + 4 <= n; i += 4) {
+        int a = idx[i], b = idx[i + 1], c = idx[i + 2], d = idx[i + 3];
+        if (a == b || a == c || a == d || b == c || b == d || c == d) {
+            for (int k = 0; k < 4; ++k) {
+                int p = idx[i + k];
+                pixels[p] = (uint32_t)_mm_cvtsi128_si32(blendOp_sse2<M>(_mm_cvtsi32_si128((int)pixels[p]), s)) & 0x00FFFFFF;
+            }
+            continue;
+        }
+        __m128i v = _mm_set_epi32((int)pixels[d], (int)pixels[c], (int)pixels[b], (int)pixels[a]);
+        alignas(16) uint32_t out[4];
+        _mm_store_si128((__m128i*)out, _mm_and_si128(blendOp_sse2<M>(v, s), _mm_set1_epi32(0x00FFFFFF)));
+        pixels[a] = out[0]; pixels[b] = out[1]; pixels[c] = out[2]; pixels[d] = out[3];
+    }
+    for (; i < n; ++i) {
+        int p = idx[i];
+        pixels[p] = (uint32_t)_mm_cvtsi128_si32(blendOp_sse2<M>(_mm_cvtsi32_si128((int)pixels[p]), s)) & 0x00FFFFFF;
+    }
+}
+
+void Window::writePointsBlend(const std::vector<POINT>& pts, color c, BlendMode mode) {
+    uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
+
+    // Clip once and turn the points into buffer offsets
+    static thread_local std::vector<int> idx;
+    idx.clear();
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    for (const POINT& p : pts) {
+        if (p.x < clipRect.left || p.x >= clipRect.right || p.y < clipRect.top || p.y >= clipRect.bottom) continue;
+        resolveClearAt(p.x, p.y);
+        idx.push_back(p.y * bufferStride + p.x);
+        minX = fastMin(minX, (int)p.x);
+        maxX = fastMax(maxX, (int)p.x);
+        minY = fastMin(minY, (int)p.y);
+        maxY = fastMax(maxY, (int)p.y);
+    }
+    if (idx.empty()) return;
+
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    switch (mode) {
+        case BlendMode::Add:      blendPoints_sse2<BlendMode::Add>(pixels, idx.data(), idx.size(), packed); break;
+        case BlendMode::Multiply: blendPoints_sse2<BlendMode::Multiply>(pixels, idx.data(), idx.size(), packed); break;
+        case BlendMode::Screen:   blendPoints_sse2<BlendMode::Screen>(pixels, idx.data(), idx.size(), packed); break;
+        case BlendMode::Darken:   blendPoints_sse2<BlendMode::Darken>(pixels, idx.data(), idx.size(), packed); break;
+        case BlendMode::Lighten:  blendPoints_sse2<BlendMode::Lighten>(pixels, idx.data(), idx.size(), packed); break;
+    }
+    markDirty(minX, minY, maxX - minX + 1, maxY - minY + 1);
+}
+
 void Window::writeAlphaBitmap(uint32_t* srcPixels, int srcW, int srcH,
                               int dstX, int dstY, BYTE alpha) {
     if (alpha == 0) return; // fully transparent
+
+    int startX = fastMax((int)clipRect.left, dstX);
+    int startY = fastMax((int)clipRect.top, dstY);
+    int endX   = fastMin((int)clipRect.right,  dstX + srcW);
+    int endY   = fastMin((int)clipRect.bottom, dstY + srcH);
+    if (startX >= endX || startY >= endY) return;
+
     if (alpha == 255) {
         // fast copy path
-        int startX = fastMax(0, dstX);
-        int startY = fastMax(0, dstY);
-        int endX   = fastMin(bufferWidth,  dstX + srcW);
-        int endY   = fastMin(bufferHeight, dstY + srcH);
-
+        coverClear(startX, startY, endX, endY);
         uint32_t* dst = static_cast<uint32_t*>(pixelBuffer);
         for (int y = startY; y < endY; ++y) {
             int sy = y - dstY;
-            memcpy(&dst[y * bufferWidth + startX],
+            memcpy(&dst[y * bufferStride + startX],
                    &srcPixels[sy * srcW + (startX - dstX)],
                    (endX - startX) * sizeof(uint32_t));
         }
+        markDirty(startX, startY, endX - startX, endY - startY);
         return;
     }
 
-    int startX = fastMax(0, dstX);
-    int startY = fastMax(0, dstY);
-    int endX   = fastMin(bufferWidth,  dstX + srcW);
-    int endY   = fastMin(bufferHeight, dstY + srcH);
-
+    resolveClear(startX, startY, endX, endY);
     uint32_t* dst = static_cast<uint32_t*>(pixelBuffer);
     __m128i alpha16 = _mm_set1_epi16(alpha);
 
     for (int y = startY; y < endY; ++y) {
         int sy = y - dstY;
-        uint32_t* dstRow = dst + y * bufferWidth + startX;
+        uint32_t* dstRow = dst + y * bufferStride + startX;
         uint32_t* srcRow = srcPixels + sy * srcW + (startX - dstX);
 
         int count = endX - startX;
@@ -419,7 +740,462 @@ void Window::writeAlphaBitmap(uint32_t* srcPixels, int srcW, int srcH,
             dstRow[i] = blendPixel(d, s, alpha); // scalar fallback
         }
     }
-    markDirty(dstX, dstY, srcW, srcH);
+    markDirty(startX, startY, endX - startX, endY - startY);
+}
+
+// Move pixels already in the back buffer. Rows are walked bottom-up when the
+// destination is below the source so overlapping copies never read a row
+// that was already overwritten; memmove handles overlap within a row.
+void Window::copyRect(int srcX, int srcY, int w, int h, int dstX, int dstY) {
+    // Clip against the source edges
+    if (srcX < 0) { w += srcX; dstX -= srcX; srcX = 0; }
+    if (srcY < 0) { h += srcY; dstY -= srcY; srcY = 0; }
+    // Clip against the destination edges (the clip rect)
+    if (dstX < clipRect.left) { int d = clipRect.left - dstX; w -= d; srcX += d; dstX = clipRect.left; }
+    if (dstY < clipRect.top)  { int d = clipRect.top  - dstY; h -= d; srcY += d; dstY = clipRect.top; }
+    w = std::min(w, std::min(bufferWidth - srcX, (int)clipRect.right - dstX));
+    h = std::min(h, std::min(bufferHeight - srcY, (int)clipRect.bottom - dstY));
+    if (w <= 0 || h <= 0) return;
+    if (srcX == dstX && srcY == dstY) return;
+    // The source must hold its cleared pixels before they are copied
+    if (pendingClears) resolveClearTiles(srcX, srcY, srcX + w, srcY + h, false);
+    coverClear(dstX, dstY, dstX + w, dstY + h);
+
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    size_t rowBytes = w * sizeof(uint32_t);
+    if (dstY > srcY) {
+        for (int row = h - 1; row >= 0; --row) {
+            memmove(&pixels[(dstY + row) * bufferStride + dstX],
+                    &pixels[(srcY + row) * bufferStride + srcX], rowBytes);
+        }
+    } else {
+        for (int row = 0; row < h; ++row) {
+            memmove(&pixels[(dstY + row) * bufferStride + dstX],
+                    &pixels[(srcY + row) * bufferStride + srcX], rowBytes);
+        }
+    }
+    markDirty(dstX, dstY, w, h);
+}
+
+// Shift the contents of area by (dx, dy). The strips uncovered by the move are
+// left untouched and written to exposed (if given) so the caller only has to
+// redraw those. Returns the number of exposed rects (0..2).
+int Window::scroll(int dx, int dy, const RECT& area, RECT* exposed) {
+    int left   = fastMax((int)clipRect.left, (int)area.left);
+    int top    = fastMax((int)clipRect.top, (int)area.top);
+    int right  = fastMin((int)clipRect.right,  (int)area.right);
+    int bottom = fastMin((int)clipRect.bottom, (int)area.bottom);
+    int w = right - left;
+    int h = bottom - top;
+    if (w <= 0 || h <= 0) return 0;
+    if (dx == 0 && dy == 0) return 0;
+
+    int adx = abs(dx), ady = abs(dy);
+    if (adx >= w || ady >= h) {
+        // Everything scrolled out, the whole area is exposed
+        if (exposed) exposed[0] = { left, top, right, bottom };
+        markDirty(left, top, w, h);
+        return 1;
+    }
+
+    copyRect(left + std::max(0, -dx), top + std::max(0, -dy), w - adx, h - ady,
+             left + std::max(0,  dx), top + std::max(0,  dy));
+
+    // The whole area changed on screen, not just the copied part
+    markDirty(left, top, w, h);
+
+    int count = 0;
+    int stripLeft = left, stripRight = right;
+    if (dx > 0) {
+        if (exposed) exposed[count] = { left, top, left + dx, bottom };
+        stripLeft = left + dx;
+        ++count;
+    } else if (dx < 0) {
+        if (exposed) exposed[count] = { right + dx, top, right, bottom };
+        stripRight = right + dx;
+        ++count;
+    }
+    if (dy > 0) {
+        if (exposed) exposed[count] = { stripLeft, top, stripRight, top + dy };
+        ++count;
+    } else if (dy < 0) {
+        if (exposed) exposed[count] = { stripLeft, bottom + dy, stripRight, bottom };
+        ++count;
+    }
+    return count;
+}
+
+// --- Strokes ---
+// A stroke is turned into convex pieces (one quad per segment, plus join and
+// cap pieces), all wound the same way. The pieces are then scan converted
+// together with the nonzero rule, so every covered pixel is written exactly
+// once no matter how many pieces overlap it.
+
+struct StrokeEdge { float yTop, yBot, x0, y0, dxdy; int dir; };
+
+static void addStrokePiece(std::vector<StrokeEdge>& edges, const StrokePt* pts, int n) {
+    // Make every piece wind the same way so the nonzero rule gives their union
+    float area = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        const StrokePt& a = pts[i];
+        const StrokePt& b = pts[(i + 1) % n];
+        area += a.x * b.y - b.x * a.y;
+    }
+    int flip = area < 0.0f ? -1 : 1;
+    for (int i = 0; i < n; ++i) {
+        StrokePt a = pts[i];
+        StrokePt b = pts[(i + 1) % n];
+        if (a.y == b.y) continue;
+        int dir = (b.y > a.y ? 1 : -1) * flip;
+        if (a.y > b.y) std::swap(a, b);
+        edges.push_back({ a.y, b.y, a.x, a.y, (b.x - a.x) / (b.y - a.y), dir });
+    }
+}
+
+static void addStrokeDisc(std::vector<StrokeEdge>& edges, StrokePt c, float r) {
+    int n = (int)ceilf(6.2831853f / acosf(std::max(-1.0f, 1.0f - 0.25f / std::max(r, 0.5f))));
+    n = std::clamp(n, 8, 128);
+    StrokePt pts[128];
+    for (int i = 0; i < n; ++i) {
+        float a = 6.2831853f * i / n;
+        pts[i] = { c.x + r * cosf(a), c.y + r * sinf(a) };
+    }
+    addStrokePiece(edges, pts, n);
+}
+
+void Window::writePolyline(const std::vector<POINT>& pts, const StrokeStyle& style, color c, bool closed) {
+    std::vector<StrokePt> fpts(pts.size());
+    for (size_t i = 0; i < pts.size(); ++i) fpts[i] = { (float)pts[i].x, (float)pts[i].y };
+    writeStrokePath(fpts, style, c, closed);
+}
+
+void Window::writeStrokePath(const std::vector<StrokePt>& pts, const StrokeStyle& style, color c, bool closed) {
+    float hw = style.width * 0.5f;
+    if (pts.empty() || hw <= 0.0f) return;
+
+    // Pixel (x, y) covers [x, x+1), so stroke along pixel centers. Drop repeated points.
+    std::vector<StrokePt> p;
+    p.reserve(pts.size());
+    for (const StrokePt& pt : pts) {
+        StrokePt q = { pt.x + 0.5f, pt.y + 0.5f };
+        if (p.empty() || q.x != p.back().x || q.y != p.back().y) p.push_back(q);
+    }
+    if (closed && p.size() > 1 && p.front().x == p.back().x && p.front().y == p.back().y) p.pop_back();
+    int n = (int)p.size();
+    if (closed && n < 3) closed = false;
+
+    std::vector<StrokeEdge> edges;
+    edges.reserve(n * 8);
+
+    if (n == 1) {
+        // A dot: only visible with a round or square cap
+        if (style.cap == LineCap::Round) addStrokeDisc(edges, p[0], hw);
+        else if (style.cap == LineCap::Square) {
+            StrokePt q[4] = { { p[0].x - hw, p[0].y - hw }, { p[0].x + hw, p[0].y - hw },
+                              { p[0].x + hw, p[0].y + hw }, { p[0].x - hw, p[0].y + hw } };
+            addStrokePiece(edges, q, 4);
+        }
+    }
+
+    int segCount = closed ? n : n - 1;
+    for (int i = 0; i < segCount; ++i) {
+        StrokePt a = p[i];
+        StrokePt b = p[(i + 1) % n];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float len = sqrtf(dx * dx + dy * dy);
+        float ux = dx / len, uy = dy / len;
+        float nx = -uy * hw, ny = ux * hw;
+
+        // Square caps extend the open ends by half the width
+        if (!closed && style.cap == LineCap::Square) {
+            if (i == 0)            { a.x -= ux * hw; a.y -= uy * hw; }
+            if (i == segCount - 1) { b.x += ux * hw; b.y += uy * hw; }
+        }
+        StrokePt quad[4] = { { a.x + nx, a.y + ny }, { b.x + nx, b.y + ny },
+                             { b.x - nx, b.y - ny }, { a.x - nx, a.y - ny } };
+        addStrokePiece(edges, quad, 4);
+    }
+
+    // Joins
+    int firstJoin = closed ? 0 : 1;
+    int lastJoin  = closed ? n : n - 1;
+    for (int i = firstJoin; i < lastJoin; ++i) {
+        StrokePt prev = p[(i - 1 + n) % n];
+        StrokePt v    = p[i];
+        StrokePt next = p[(i + 1) % n];
+        float ix = v.x - prev.x, iy = v.y - prev.y;
+        float ox = next.x - v.x, oy = next.y - v.y;
+        float il = sqrtf(ix * ix + iy * iy), ol = sqrtf(ox * ox + oy * oy);
+        ix /= il; iy /= il; ox /= ol; oy /= ol;
+        float cross = ix * oy - iy * ox;
+        float dot   = ix * ox + iy * oy;
+        if (fabsf(cross) < 1e-6f && dot > 0.0f) continue; // straight through
+
+        if (style.join == LineJoin::Round) {
+            addStrokeDisc(edges, v, hw);
+            continue;
+        }
+        // Outer side of the turn
+        float s = cross > 0.0f ? -1.0f : 1.0f;
+        StrokePt e1 = { v.x - iy * hw * s, v.y + ix * hw * s };
+        StrokePt e2 = { v.x - oy * hw * s, v.y + ox * hw * s };
+        // Miter length relative to the half width is 1 / cos(theta / 2)
+        float cosHalf = sqrtf(fastMax(0.0f, (1.0f + dot) * 0.5f));
+        if (style.join == LineJoin::Miter && cosHalf > 1e-4f && 1.0f / cosHalf <= style.miterLimit) {
+            float mx = (-iy - oy), my = (ix + ox);
+            float ml = sqrtf(mx * mx + my * my);
+            float len = hw / cosHalf;
+            StrokePt tip = { v.x + mx / ml * len * s, v.y + my / ml * len * s };
+            StrokePt q[4] = { v, e1, tip, e2 };
+            addStrokePiece(edges, q, 4);
+        } else {
+            StrokePt t[3] = { v, e1, e2 };
+            addStrokePiece(edges, t, 3);
+        }
+    }
+
+    // Round caps
+    if (!closed && n > 1 && style.cap == LineCap::Round) {
+        addStrokeDisc(edges, p[0], hw);
+        addStrokeDisc(edges, p[n - 1], hw);
+    }
+    if (edges.empty()) return;
+
+    // Bounding box, trivial reject
+    float minX = edges[0].x0, maxX = edges[0].x0, minY = edges[0].yTop, maxY = edges[0].yBot;
+    for (const StrokeEdge& e : edges) {
+        float xEnd = e.x0 + (e.yBot - e.yTop) * e.dxdy;
+        minX = std::min(minX, std::min(e.x0, xEnd));
+        maxX = std::max(maxX, std::max(e.x0, xEnd));
+        minY = fastMin(minY, e.yTop);
+        maxY = fastMax(maxY, e.yBot);
+    }
+    int bx0 = (int)floorf(minX), by0 = (int)floorf(minY);
+    int bx1 = (int)ceilf(maxX),  by1 = (int)ceilf(maxY);
+    if (clipReject(bx0, by0, bx1, by1)) return;
+
+    uint32_t packed = (c.r) | (c.g << 8) | (c.b << 16);
+    std::sort(edges.begin(), edges.end(),
+              [](const StrokeEdge& a, const StrokeEdge& b) { return a.yTop < b.yTop; });
+
+    const int subSamples = style.antialias ? 4 : 1;
+    int yStart = fastMax(by0, (int)clipRect.top);
+    int yEnd   = fastMin(by1, (int)clipRect.bottom);
+    int cx0 = fastMax(bx0, (int)clipRect.left);
+    int cx1 = fastMin(bx1, (int)clipRect.right);
+
+    std::vector<int> active;
+    std::vector<std::pair<float, int>> xs;
+    std::vector<float> coverage;
+    if (style.antialias) coverage.assign(cx1 - cx0 + 1, 0.0f);
+    size_t next = 0;
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+
+    for (int y = yStart; y < yEnd; ++y) {
+        for (int s = 0; s < subSamples; ++s) {
+            float sy = y + (s + 0.5f) / subSamples;
+            while (next < edges.size() && edges[next].yTop <= sy) active.push_back((int)next++);
+            xs.clear();
+            for (size_t k = 0; k < active.size(); ) {
+                const StrokeEdge& e = edges[active[k]];
+                if (e.yBot <= sy) { active[k] = active.back(); active.pop_back(); continue; }
+                if (e.yTop <= sy) xs.push_back({ e.x0 + (sy - e.y0) * e.dxdy, e.dir });
+                ++k;
+            }
+            std::sort(xs.begin(), xs.end());
+
+            // Nonzero winding spans
+            int winding = 0;
+            for (size_t k = 0; k + 1 < xs.size(); ++k) {
+                winding += xs[k].second;
+                if (winding == 0) continue;
+                float xa = xs[k].first, xb = xs[k + 1].first;
+                if (xb <= xa) continue;
+                if (!style.antialias) {
+                    fillClippedSpan(y, (int)ceilf(xa - 0.5f), (int)ceilf(xb - 0.5f) - 1, packed);
+                    continue;
+                }
+                // Accumulate horizontal coverage for this sub-scanline
+                float w = 1.0f / subSamples;
+                xa = fastMax(xa, (float)cx0);
+                xb = fastMin(xb, (float)cx1);
+                if (xb <= xa) continue;
+                int ia = (int)xa, ib = (int)xb;
+                if (ia == ib) { coverage[ia - cx0] += (xb - xa) * w; continue; }
+                coverage[ia - cx0] += (ia + 1 - xa) * w;
+                for (int x = ia + 1; x < ib; ++x) coverage[x - cx0] += w;
+                coverage[ib - cx0] += (xb - ib) * w;
+            }
+        }
+
+        if (style.antialias) {
+            uint32_t* row = pixels + y * bufferStride;
+            for (int x = cx0; x < cx1; ++x) {
+                float cov = coverage[x - cx0];
+                if (cov <= 0.0f) continue;
+                coverage[x - cx0] = 0.0f;
+                resolveClearAt(x, y);
+                int a = (int)(cov * 255.0f + 0.5f);
+                row[x] = a >= 255 ? packed : blendPixel(row[x], packed, (uint8_t)a);
+            }
+            coverage[cx1 - cx0] = 0.0f;
+        }
+    }
+    markDirty(bx0, by0, bx1 - bx0, by1 - by0);
+}
+
+void Window::writeStrokeRect(int x, int y, int w, int h, const StrokeStyle& style, color c) {
+    std::vector<POINT> pts = { { x, y }, { x + w - 1, y }, { x + w - 1, y + h - 1 }, { x, y + h - 1 } };
+    writePolyline(pts, style, c, true);
+}
+
+void Window::writeStrokePolygon(const std::vector<POINT>& pts, const StrokeStyle& style, color c) {
+    writePolyline(pts, style, c, true);
+}
+
+void Window::writeStrokeEllipse(int cx, int cy, int rx, int ry, const StrokeStyle& style, color c) {
+    int r = fastMax(rx, ry);
+    int n = std::clamp((int)ceilf(6.2831853f * r / 4.0f), 12, 512);
+    // Kept in float: rounding the vertices to pixels makes the outline wobble
+    std::vector<StrokePt> pts(n);
+    for (int i = 0; i < n; ++i) {
+        float a = 6.2831853f * i / n;
+        pts[i] = { cx + rx * cosf(a), cy + ry * sinf(a) };
+    }
+    StrokeStyle s = style;
+    s.join = LineJoin::Bevel; // vertices are close together, bevels are invisible
+    writeStrokePath(pts, s, c, true);
+}
+
+// Lazy clear: settle the pending clear of every tile overlapping the rect.
+// opaque means the caller is about to overwrite the whole rect, so tiles fully
+// inside it just drop the clear; all other overlapping tiles are filled now.
+void Window::resolveClearTiles(int left, int top, int right, int bottom, bool opaque) {
+    left   = fastMax(left, 0);
+    top    = fastMax(top, 0);
+    right  = fastMin(right, bufferWidth);
+    bottom = fastMin(bottom, bufferHeight);
+    if (left >= right || top >= bottom) return;
+
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    const uint32_t* src = nullptr; // restore source, looked up on first use
+    int srcStride = 0, srcW = 0, srcH = 0;
+    int tx0 = left / clearTileSize, tx1 = (right - 1) / clearTileSize;
+    int ty0 = top / clearTileSize,  ty1 = (bottom - 1) / clearTileSize;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            uint8_t& pending = clearTiles[ty * clearTilesX + tx];
+            if (!pending) continue;
+            bool restore = pending == 2;
+            pending = 0;
+            --pendingClears;
+
+            int x0 = tx * clearTileSize, y0 = ty * clearTileSize;
+            int x1 = fastMin(x0 + clearTileSize, bufferWidth);
+            int y1 = fastMin(y0 + clearTileSize, bufferHeight);
+            if (opaque && x0 >= left && y0 >= top && x1 <= right && y1 <= bottom) continue;
+            if (!restore) {
+                for (int y = y0; y < y1; ++y) {
+                    fillSpan(pixels + y * bufferStride + x0, x1 - x0, clearColor);
+                }
+                continue;
+            }
+
+            // Copy the tile back from the last presented frame; whatever that
+            // frame did not cover (the buffer grew) comes out black
+            if (!src && !restoreSource(src, srcStride, srcW, srcH)) srcW = srcH = 0;
+            int copyEnd = std::max(x0, std::min(x1, srcW));
+            for (int y = y0; y < y1; ++y) {
+                uint32_t* row = pixels + y * bufferStride;
+                if (y < srcH && copyEnd > x0) {
+                    memcpy(row + x0, src + (size_t)y * srcStride + x0, (copyEnd - x0) * sizeof(uint32_t));
+                    fillSpan(row + copyEnd, x1 - copyEnd, 0);
+                } else {
+                    fillSpan(row + x0, x1 - x0, 0);
+                }
+            }
+        }
+    }
+}
+
+// Flag the tiles overlapping the rect as holding stale pixels that must be
+// copied back from the last presented frame before anything partially draws
+// over them. Tiles already waiting for a clear keep waiting for the clear.
+void Window::markRestore(int left, int top, int right, int bottom) {
+    left   = std::max(left, 0);
+    top    = std::max(top, 0);
+    right  = std::min(right, bufferWidth);
+    bottom = std::min(bottom, bufferHeight);
+    if (left >= right || top >= bottom) return;
+
+    if (!pendingClears) {
+        clearTilesX = (bufferWidth  + clearTileSize - 1) / clearTileSize;
+        clearTilesY = (bufferHeight + clearTileSize - 1) / clearTileSize;
+        clearTiles.assign((size_t)clearTilesX * clearTilesY, 0);
+    }
+    int tx0 = left / clearTileSize, tx1 = (right - 1) / clearTileSize;
+    int ty0 = top / clearTileSize,  ty1 = (bottom - 1) / clearTileSize;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            uint8_t& pending = clearTiles[ty * clearTilesX + tx];
+            if (pending) continue;
+            pending = 2;
+            ++pendingClears;
+        }
+    }
+}
+
+// The last presented frame: the newest export slot, or the local buffer the
+// renderer drew into before export was enabled
+bool Window::restoreSource(const uint32_t*& px, int& stride, int& w, int& h) const {
+    px = frameExport.publishedPixels(w, h);
+    if (px) { stride = w; return true; }
+    if (internalWidth != 0) {
+        px = internalPixels.data();
+        stride = w = internalWidth;
+        h = internalHeight;
+    } else {
+        px = static_cast<const uint32_t*>(windowPixels);
+        stride = windowStride;
+        w = windowWidth;
+        h = windowHeight;
+    }
+    return px != nullptr && px != pixelBuffer;
+}
+
+// Restrict drawing to (x, y, w, h) intersected with the current clip rect.
+// Every primitive rejects and clips against the top of this stack.
+void Window::pushClipRect(int x, int y, int w, int h) {
+    RECT r = { x, y, x + w, y + h };
+    if (!clipStack.empty()) {
+        const RECT& parent = clipStack.back();
+        r.left   = fastMax(r.left,   parent.left);
+        r.top    = fastMax(r.top,    parent.top);
+        r.right  = fastMin(r.right,  parent.right);
+        r.bottom = fastMin(r.bottom, parent.bottom);
+    }
+    clipStack.push_back(r);
+    updateClipRect();
+}
+
+void Window::popClipRect() {
+    if (clipStack.empty()) return;
+    clipStack.pop_back();
+    updateClipRect();
+}
+
+void Window::updateClipRect() {
+    clipRect = { 0, 0, bufferWidth, bufferHeight };
+    if (!clipStack.empty()) {
+        const RECT& top = clipStack.back();
+        clipRect.left   = fastMax(clipRect.left,   top.left);
+        clipRect.top    = fastMax(clipRect.top,    top.top);
+        clipRect.right  = fastMin(clipRect.right,  top.right);
+        clipRect.bottom = fastMin(clipRect.bottom, top.bottom);
+    }
+    // Keep empty clips well-formed so reject tests stay simple
+    if (clipRect.right < clipRect.left) clipRect.right = clipRect.left;
+    if (clipRect.bottom < clipRect.top) clipRect.bottom = clipRect.top;
 }
 
 HBITMAP Window::loadBitmap(const WCHAR* filename, void** outPixels, int* w, int* h) {
@@ -472,36 +1248,317 @@ inline void Window::markDirty(int x, int y, int w, int h) {
     if (dirtyRect.bottom > bufferHeight) dirtyRect.bottom = bufferHeight;
 }
 
+// The DIB is allocated with spare capacity (rows are bufferStride pixels apart),
+// so resizes that still fit only change the logical size and keep the content.
 void Window::createBackBuffer(int width, int height) {
-    if (width == bufferWidth && height == bufferHeight && backBitmap) return;
-
-    if (backDC && backOldBitmap) {
-        SelectObject(backDC, backOldBitmap);
+    if (width == windowWidth && height == windowHeight && backBitmap) return;
+    if (pendingClears) resolveClearTiles(0, 0, bufferWidth, bufferHeight, false);
+
+    bool fits = backBitmap && width <= windowCapWidth && height <= windowCapHeight;
+    // Give memory back after a big shrink (e.g. leaving fullscreen)
+    bool wasteful = (size_t)width * height * 4 < (size_t)windowCapWidth * windowCapHeight;
+    if (fits && !wasteful) {
+        windowWidth  = width;
+        windowHeight = height;
+        selectDrawBuffer();
+        updateUpscaleLayout();
+        return;
     }
-    if (backBitmap) { DeleteObject(backBitmap); backBitmap = nullptr; }
-    if (backDC)     { DeleteDC(backDC);         backDC = nullptr; }
 
     HDC screenDC = GetDC(hwnd);
-    backDC = CreateCompatibleDC(screenDC);
+
+    // Round up so a resize drag doesn't reallocate on every step
+    int capWidth  = (width  + width  / 4 + 63) & ~63;
+    int capHeight = (height + height / 4 + 63) & ~63;
 
     // Fill in the member bmi
     ZeroMemory(&bmi, sizeof(bmi));
     bmi.bmiHeader.biSize        = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth       = width;
-    bmi.bmiHeader.biHeight      = -height; // top-down
+    bmi.bmiHeader.biWidth       = capWidth;
+    bmi.bmiHeader.biHeight      = -capHeight; // top-down
     bmi.bmiHeader.biPlanes      = 1;
     bmi.bmiHeader.biBitCount    = 32;
     bmi.bmiHeader.biCompression = BI_RGB;
 
-    backBitmap = CreateDIBSection(screenDC, &bmi, DIB_RGB_COLORS, &pixelBuffer, nullptr, 0);
+    void* newPixels = nullptr;
+    HBITMAP newBitmap = CreateDIBSection(screenDC, &bmi, DIB_RGB_COLORS, &newPixels, nullptr, 0);
+
+    // Carry the old content over so the first frame at the new size isn't black
+    if (backBitmap && windowPixels && newPixels) {
+        int rows = fastMin(height, windowHeight);
+        int cols = fastMin(width, windowWidth);
+        for (int y = 0; y < rows; ++y) {
+            memcpy(static_cast<uint32_t*>(newPixels) + (size_t)y * capWidth,
+                   static_cast<uint32_t*>(windowPixels) + (size_t)y * windowStride,
+                   cols * sizeof(uint32_t));
+        }
+    }
+
+    if (backDC && backOldBitmap) {
+        SelectObject(backDC, backOldBitmap);
+    }
+    if (backBitmap) { DeleteObject(backBitmap); backBitmap = nullptr; }
+    if (backDC)     { DeleteDC(backDC);         backDC = nullptr; }
+
+    backDC = CreateCompatibleDC(screenDC);
+    backBitmap = newBitmap;
+    windowPixels = newPixels;
     backOldBitmap = (HBITMAP)SelectObject(backDC, backBitmap);
 
-    bufferWidth  = width;
-    bufferHeight = height;
+    windowStride    = capWidth;
+    windowCapWidth  = capWidth;
+    windowCapHeight = capHeight;
+    windowWidth  = width;
+    windowHeight = height;
+    selectDrawBuffer();
+    updateUpscaleLayout();
 
     ReleaseDC(hwnd, screenDC);
 }
 
+// Point pixelBuffer at the storage the primitives should draw into: the DIB,
+// the internal low-res buffer, or the current shared-memory export slot.
+void Window::selectDrawBuffer() {
+    if (internalWidth == 0) {
+        pixelBuffer  = windowPixels;
+        bufferWidth  = windowWidth;
+        bufferHeight = windowHeight;
+        bufferStride = windowStride;
+    } else {
+        pixelBuffer  = internalPixels.data();
+        bufferWidth  = internalWidth;
+        bufferHeight = internalHeight;
+        bufferStride = internalWidth;
+    }
+    if (frameExport.isOpen()) {
+        uint32_t* slot = frameExport.beginFrame(bufferWidth, bufferHeight);
+        if (slot) {
+            pixelBuffer = slot;
+            bufferStride = bufferWidth;
+            // The slot's old rows don't match the new size; start from the last frame
+            pendingClears = 0;
+            markRestore(0, 0, bufferWidth, bufferHeight);
+        } else {
+            frameExport.close(); // out of shared memory, keep rendering locally
+        }
+    }
+
+    // Describes pixelBuffer for StretchDIBits
+    bufferBmi = bmi;
+    bufferBmi.bmiHeader.biWidth  = bufferStride;
+    bufferBmi.bmiHeader.biHeight = -bufferHeight;
+
+    prevFrame.clear();
+    updateClipRect();
+}
+
+void Window::setInternalResolution(int w, int h) {
+    pendingClears = 0; // the old buffer is discarded or left as is
+    if (w <= 0 || h <= 0) {
+        internalWidth = internalHeight = 0;
+        internalPixels.clear();
+        internalPixels.shrink_to_fit();
+    } else {
+        internalWidth  = w;
+        internalHeight = h;
+        internalPixels.assign((size_t)w * h, 0);
+    }
+    selectDrawBuffer();
+    updateUpscaleLayout();
+    hasDirty = false;
+    isAllDirty = false;
+}
+
+bool Window::enableFrameExport(const char* name, int slots) {
+    if (pendingClears) resolveClearTiles(0, 0, bufferWidth, bufferHeight, false);
+    if (!frameExport.open(name, bufferWidth, bufferHeight, slots)) return false;
+    exportChangeCount = 0;
+    selectDrawBuffer();
+    return true;
+}
+
+void Window::disableFrameExport() {
+    if (!frameExport.isOpen()) return;
+    // Carry the frame in progress over to the local buffer drawing continues in
+    if (pendingClears) resolveClearTiles(0, 0, bufferWidth, bufferHeight, false);
+    const uint32_t* slot = static_cast<const uint32_t*>(pixelBuffer);
+    uint32_t* local = internalWidth != 0 ? internalPixels.data() : static_cast<uint32_t*>(windowPixels);
+    int localStride = internalWidth != 0 ? internalWidth : windowStride;
+    for (int y = 0; y < bufferHeight; ++y) {
+        memcpy(local + (size_t)y * localStride, slot + (size_t)y * bufferStride, bufferWidth * sizeof(uint32_t));
+    }
+    frameExport.close();
+    selectDrawBuffer();
+}
+
+// Map an output coordinate to the left/top source pixel and an 8-bit weight
+static inline void bilerpCoord(int o, int k, int& s0, int& w) {
+    int f = ((2 * o + 1) * 256) / (2 * k) - 128; // source position in 1/256ths
+    s0 = f >> 8;
+    w  = f & 255;
+    if (s0 < 0) { s0 = 0; w = 0; }
+}
+
+void Window::updateUpscaleLayout() {
+    letterboxDirty = true;
+    if (internalWidth == 0) {
+        upscaleFactor = 1;
+        upscaleOffsetX = upscaleOffsetY = 0;
+        return;
+    }
+    upscaleFactor = std::max(1, std::min(windowWidth / internalWidth, windowHeight / internalHeight));
+    // Negative when the window is smaller than the internal buffer, which crops
+    upscaleOffsetX = (windowWidth  - internalWidth  * upscaleFactor) / 2;
+    upscaleOffsetY = (windowHeight - internalHeight * upscaleFactor) / 2;
+
+    // Source column and weights for every visible output column
+    int x0 = std::max(0, upscaleOffsetX);
+    int x1 = std::min(windowWidth, upscaleOffsetX + internalWidth * upscaleFactor);
+    int n = std::max(0, x1 - x0);
+    bilerpSrcX.resize(n);
+    bilerpWeightX.resize((size_t)n * 8);
+    for (int i = 0; i < n; ++i) {
+        int sx, wx;
+        bilerpCoord(x0 + i - upscaleOffsetX, upscaleFactor, sx, wx);
+        bilerpSrcX[i] = sx;
+        for (int c = 0; c < 4; ++c) {
+            bilerpWeightX[i * 8 + c]     = (uint16_t)(256 - wx);
+            bilerpWeightX[i * 8 + 4 + c] = (uint16_t)wx;
+        }
+    }
+}
+
+// dst = (a * (256 - w) + b * w) >> 8 per channel, 4 pixels per step. Products
+// stay below 65536 so unsigned 16-bit lanes are enough.
+static void lerpRows_sse2(uint32_t* dst, const uint32_t* a, const uint32_t* b, int n, int w) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i wa = _mm_set1_epi16((short)(256 - w));
+    __m128i wb = _mm_set1_epi16((short)w);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i*)&a[i]);
+        __m128i vb = _mm_loadu_si128((const __m128i*)&b[i]);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    for (; i < n; ++i) {
+        uint32_t pa = a[i], pb = b[i], out = 0;
+        for (int sh = 0; sh < 24; sh += 8) {
+            out |= ((((pa >> sh) & 255) * (256 - w) + ((pb >> sh) & 255) * w) >> 8) << sh;
+        }
+        dst[i] = out;
+    }
+}
+
+// Horizontal pass: one 64-bit load fetches both source neighbours of an output
+// pixel, the per-column weights come from the table, 4 output pixels per store
+static void lerpColumns_sse2(uint32_t* dst, const uint32_t* row, const int* srcX,
+                             const uint16_t* weights, int n) {
+    __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i p[4];
+        for (int j = 0; j < 4; ++j) {
+            __m128i pair = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&row[srcX[i + j]]), zero);
+            p[j] = _mm_mullo_epi16(pair, _mm_loadu_si128((const __m128i*)&weights[(i + j) * 8]));
+        }
+        // Left half + right half of each product gives the blended pixel
+        __m128i v01 = _mm_add_epi16(_mm_unpacklo_epi64(p[0], p[1]), _mm_unpackhi_epi64(p[0], p[1]));
+        __m128i v23 = _mm_add_epi16(_mm_unpacklo_epi64(p[2], p[3]), _mm_unpackhi_epi64(p[2], p[3]));
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_packus_epi16(_mm_srli_epi16(v01, 8), _mm_srli_epi16(v23, 8)));
+    }
+    for (; i < n; ++i) {
+        __m128i pair = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&row[srcX[i]]), zero);
+        __m128i v = _mm_mullo_epi16(pair, _mm_loadu_si128((const __m128i*)&weights[i * 8]));
+        v = _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_si128(v, 8)), 8);
+        dst[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+    }
+}
+
+void Window::upscaleToWindow() {
+    uint32_t* out = static_cast<uint32_t*>(windowPixels);
+    const uint32_t* src = static_cast<const uint32_t*>(pixelBuffer);
+    int k = upscaleFactor;
+
+    // Visible part of the upscaled image in window coordinates
+    int x0 = fastMax(0, upscaleOffsetX);
+    int y0 = fastMax(0, upscaleOffsetY);
+    int x1 = fastMin(windowWidth,  upscaleOffsetX + internalWidth  * k);
+    int y1 = fastMin(windowHeight, upscaleOffsetY + internalHeight * k);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    if (letterboxDirty) {
+        for (int y = 0; y < windowHeight; ++y) {
+            uint32_t* row = out + (size_t)y * windowStride;
+            if (y < y0 || y >= y1) { fillSpan(row, windowWidth, 0); continue; }
+            fillSpan(row, x0, 0);
+            fillSpan(row + x1, windowWidth - x1, 0);
+        }
+        letterboxDirty = false;
+    }
+
+    if (upscaleBilinear && k > 1) {
+        // Blend the two source rows vertically, then sample that row horizontally.
+        // The extra last pixel repeats the edge so the right neighbour always exists.
+        upscaleRow.resize(internalWidth + 1);
+        uint32_t* vrow = upscaleRow.data();
+        for (int y = y0; y < y1; ++y) {
+            int sy0, wy;
+            bilerpCoord(y - upscaleOffsetY, k, sy0, wy);
+            int sy1 = std::min(sy0 + 1, internalHeight - 1);
+            const uint32_t* r0 = src + sy0 * internalWidth;
+            if (wy == 0) memcpy(vrow, r0, internalWidth * sizeof(uint32_t));
+            else lerpRows_sse2(vrow, r0, src + sy1 * internalWidth, internalWidth, wy);
+            vrow[internalWidth] = vrow[internalWidth - 1];
+            lerpColumns_sse2(out + (size_t)y * windowStride + x0, vrow,
+                             bilerpSrcX.data(), bilerpWeightX.data(), x1 - x0);
+        }
+        return;
+    }
+
+    // Nearest: widen each source row once, then copy it to its k output rows
+    int rowLen = internalWidth * k;
+    upscaleRow.resize(rowLen);
+    uint32_t* wide = upscaleRow.data();
+    int srcFirst = (y0 - upscaleOffsetY) / k;
+    int srcLast  = (y1 - 1 - upscaleOffsetY) / k;
+    for (int sy = srcFirst; sy <= srcLast; ++sy) {
+        const uint32_t* s = src + sy * internalWidth;
+        int i = 0;
+        if (k == 1) {
+            memcpy(wide, s, internalWidth * sizeof(uint32_t));
+        } else if (k == 2) {
+            for (; i + 4 <= internalWidth; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+                _mm_storeu_si128((__m128i*)&wide[i * 2],     _mm_unpacklo_epi32(v, v));
+                _mm_storeu_si128((__m128i*)&wide[i * 2 + 4], _mm_unpackhi_epi32(v, v));
+            }
+            for (; i < internalWidth; ++i) wide[i * 2] = wide[i * 2 + 1] = s[i];
+        } else if (k == 3) {
+            for (; i + 4 <= internalWidth; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+                // a a a b | b b c c | c d d d
+                _mm_storeu_si128((__m128i*)&wide[i * 3],     _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+                _mm_storeu_si128((__m128i*)&wide[i * 3 + 4], _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_si128((__m128i*)&wide[i * 3 + 8], _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+            }
+            for (; i < internalWidth; ++i) wide[i * 3] = wide[i * 3 + 1] = wide[i * 3 + 2] = s[i];
+        } else {
+            for (; i < internalWidth; ++i) fillSpan(wide + i * k, k, s[i]);
+        }
+
+        int oyStart = fastMax(y0, upscaleOffsetY + sy * k);
+        int oyEnd   = fastMin(y1, upscaleOffsetY + (sy + 1) * k);
+        for (int oy = oyStart; oy < oyEnd; ++oy) {
+            memcpy(out + (size_t)oy * windowStride + x0, wide + (x0 - upscaleOffsetX),
+                   (x1 - x0) * sizeof(uint32_t));
+        }
+    }
+}
+
 bool Window::update() {
     MSG msg = {};
     while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
@@ -522,9 +1579,129 @@ bool Window::update() {
     return true; // still running
 }
 
+void Window::pushInput(InputType type, MouseButton button, uint32_t key, int wheel, bool repeat) {
+    InputEvent e;
+    e.timestamp = inputNow();
+    e.type   = type;
+    e.button = button;
+    e.repeat = repeat;
+    e.x      = mouseX;
+    e.y      = mouseY;
+    e.wheel  = wheel;
+    e.key    = key;
+    inputQueue.push(e);
+}
+
+// Called right after the frame hits the screen
+void Window::recordInputLatency() {
+    if (pendingInputTime == 0) return;
+    inputLatency = (inputNow() - pendingInputTime) / 1e9f;
+    pendingInputTime = 0;
+}
+
+// True if the n pixels at a and b differ, stops at the first difference
+static inline bool spanDiffers(const uint32_t* a, const uint32_t* b, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i eq0 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&a[i]),
+                                      _mm_loadu_si128((const __m128i*)&b[i]));
+        __m128i eq1 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&a[i + 4]),
+                                      _mm_loadu_si128((const __m128i*)&b[i + 4]));
+        if (_mm_movemask_epi8(_mm_and_si128(eq0, eq1)) != 0xFFFF) return true;
+    }
+    for (; i < n; ++i) {
+        if (a[i] != b[i]) return true;
+    }
+    return false;
+}
+
+void Window::presentChangedTiles(HDC hdc) {
+    uint32_t* pixels = static_cast<uint32_t*>(pixelBuffer);
+    size_t count = (size_t)bufferStride * bufferHeight;
+
+    // First frame (or after a resize): upload everything
+    if (prevFrame.size() != count) {
+        prevFrame.assign(pixels, pixels + count);
+        StretchDIBits(hdc,
+            0, 0, bufferWidth, bufferHeight,
+            0, 0, bufferWidth, bufferHeight,
+            pixelBuffer, &bufferBmi, DIB_RGB_COLORS, SRCCOPY);
+        return;
+    }
+
+    int tilesX = (bufferWidth  + diffTileSize - 1) / diffTileSize;
+    int tilesY = (bufferHeight + diffTileSize - 1) / diffTileSize;
+    changedTiles.assign((size_t)tilesX, 0);
+
+    for (int ty = 0; ty < tilesY; ++ty) {
+        int y0 = ty * diffTileSize;
+        int y1 = fastMin(bufferHeight, y0 + diffTileSize);
+
+        // Compare, and refresh the copy of, every changed tile in this row
+        for (int tx = 0; tx < tilesX; ++tx) {
+            int x0 = tx * diffTileSize;
+            int w  = fastMin(diffTileSize, bufferWidth - x0);
+            bool changed = false;
+            for (int y = y0; y < y1; ++y) {
+                size_t off = (size_t)y * bufferStride + x0;
+                if (spanDiffers(pixels + off, prevFrame.data() + off, w)) {
+                    // Rows above y matched, only copy from here down
+                    for (int yy = y; yy < y1; ++yy) {
+                        size_t o = (size_t)yy * bufferStride + x0;
+                        memcpy(prevFrame.data() + o, pixels + o, w * sizeof(uint32_t));
+                    }
+                    changed = true;
+                    break;
+                }
+            }
+            changedTiles[tx] = changed;
+        }
+
+        // Upload runs of adjacent changed tiles with one call each
+        for (int tx = 0; tx < tilesX; ) {
+            if (!changedTiles[tx]) { ++tx; continue; }
+            int runStart = tx;
+            while (tx < tilesX && changedTiles[tx]) ++tx;
+            int x0 = runStart * diffTileSize;
+            int x1 = fastMin(bufferWidth, tx * diffTileSize);
+            StretchDIBits(hdc,
+                x0, y0, x1 - x0, y1 - y0,
+                x0, y0, x1 - x0, y1 - y0,
+                pixelBuffer, &bufferBmi, DIB_RGB_COLORS, SRCCOPY);
+        }
+    }
+}
+
 void Window::present() {
-    if(useMarkDirty) {
-        if (!hasDirty) return; // nothing changed
+    // Tiles nothing drew over still need their clear
+    if (pendingClears) resolveClearTiles(0, 0, bufferWidth, bufferHeight, false);
+    // What this frame changed, for bringing older export slots up to date
+    RECT frameChange = { 0, 0, bufferWidth, bufferHeight };
+    if (useMarkDirty && !isAllDirty) frameChange = hasDirty ? dirtyRect : RECT{ 0, 0, 0, 0 };
+
+    if (internalWidth != 0) {
+        // Low-res mode always uploads the whole upscaled frame
+        upscaleToWindow();
+        HDC hdc = GetDC(hwnd);
+        StretchDIBits(hdc,
+            0, 0, windowWidth, windowHeight,
+            0, 0, windowWidth, windowHeight,
+            windowPixels, &bmi, DIB_RGB_COLORS, SRCCOPY);
+        ReleaseDC(hwnd, hdc);
+        hasDirty = false;
+        isAllDirty = false;
+    } else if (useAutoDirty) {
+        HDC hdc = GetDC(hwnd);
+        presentChangedTiles(hdc);
+        ReleaseDC(hwnd, hdc);
+        hasDirty = false;
+        isAllDirty = false;
+    } else if(useMarkDirty) {
+        if (!hasDirty) {
+            // Nothing to upload, but input consumed this frame has still been handled
+            recordInputLatency();
+            return;
+        }
 
         HDC hdc = GetDC(hwnd);
         int w = dirtyRect.right - dirtyRect.left;
@@ -534,7 +1711,7 @@ void Window::present() {
             StretchDIBits(hdc,
                 dirtyRect.left, dirtyRect.top, w, h,
                 dirtyRect.left, dirtyRect.top, w, h,
-                pixelBuffer, &bmi, DIB_RGB_COLORS, SRCCOPY);
+                pixelBuffer, &bufferBmi, DIB_RGB_COLORS, SRCCOPY);
         }
 
         ReleaseDC(hwnd, hdc);
@@ -545,9 +1722,32 @@ void Window::present() {
         StretchDIBits(hdc,
             0, 0, bufferWidth, bufferHeight,
             0, 0, bufferWidth, bufferHeight,
-            pixelBuffer, &bmi, DIB_RGB_COLORS, SRCCOPY);
+            pixelBuffer, &bufferBmi, DIB_RGB_COLORS, SRCCOPY);
         ReleaseDC(hwnd, hdc);
     }
+    recordInputLatency();
+
+    if (frameExport.isOpen()) {
+        // Hand the finished frame to the consumer and start drawing into the next slot
+        frameExport.publish();
+        for (int i = FRAME_EXPORT_MAX_SLOTS - 1; i > 0; --i) exportChanges[i] = exportChanges[i - 1];
+        exportChanges[0] = frameChange;
+        exportChangeCount = std::min(exportChangeCount + 1, FRAME_EXPORT_MAX_SLOTS);
+
+        uint32_t* slot = frameExport.beginFrame(bufferWidth, bufferHeight);
+        if (!slot) { frameExport.close(); selectDrawBuffer(); return; }
+        pixelBuffer = slot;
+        // The slot is a few frames old; only what changed since needs restoring
+        int age = frameExport.currentSlotAge();
+        if (age == 0 || age > exportChangeCount) {
+            markRestore(0, 0, bufferWidth, bufferHeight);
+        } else {
+            for (int i = 0; i < age; ++i) {
+                markRestore(exportChanges[i].left, exportChanges[i].top,
+                            exportChanges[i].right, exportChanges[i].bottom);
+            }
+        }
+    }
 }
 
 LRESULT CALLBACK Window::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -566,17 +1766,43 @@ LRESULT CALLBACK Window::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
             return 0;
         }
         case WM_KEYDOWN:
-            if (wParam == VK_F11) self->setFullscreen(!self->isFullscreen()); return 0;
+        case WM_SYSKEYDOWN: {
+            bool repeat = (lParam & (1 << 30)) != 0;
+            self->pushInput(InputType::KeyDown, MouseButton::None, (uint32_t)wParam, 0, repeat);
+            if (wParam == VK_F11 && !repeat) { self->setFullscreen(!self->isFullscreen()); return 0; }
+            if (msg == WM_SYSKEYDOWN) break; // keep Alt+F4 etc. working
+            return 0;
+        }
+        case WM_KEYUP:
+        case WM_SYSKEYUP:
+            self->pushInput(InputType::KeyUp, MouseButton::None, (uint32_t)wParam);
+            if (msg == WM_SYSKEYUP) break;
+            return 0;
+        case WM_CHAR:
+            self->pushInput(InputType::Char, MouseButton::None, (uint32_t)wParam);
+            return 0;
         case WM_MOUSEMOVE:
             self->mouseX = (int)(short)LOWORD(lParam);
             self->mouseY = (int)(short)HIWORD(lParam);
+            if (self->internalWidth != 0) {
+                // Window to internal space, floor division so the borders go negative
+                int mx = self->mouseX - self->upscaleOffsetX;
+                int my = self->mouseY - self->upscaleOffsetY;
+                int k  = self->upscaleFactor;
+                self->mouseX = mx >= 0 ? mx / k : -((-mx + k - 1) / k);
+                self->mouseY = my >= 0 ? my / k : -((-my + k - 1) / k);
+            }
+            self->pushInput(InputType::MouseMove);
             return 0;
-        case WM_LBUTTONDOWN: self->leftDown = true; return 0;
-        case WM_LBUTTONUP:   self->leftDown = false; return 0;
-        case WM_RBUTTONDOWN: self->rightDown = true; return 0;
-        case WM_RBUTTONUP:   self->rightDown = false; return 0;
-        case WM_MBUTTONDOWN: self->middleDown = true; return 0;
-        case WM_MBUTTONUP:   self->middleDown = false; return 0;
+        case WM_MOUSEWHEEL: // lParam is in screen coordinates, keep the last client position
+            self->pushInput(InputType::MouseWheel, MouseButton::None, 0, GET_WHEEL_DELTA_WPARAM(wParam));
+            return 0;
+        case WM_LBUTTONDOWN: self->leftDown = true;    self->pushInput(InputType::MouseDown, MouseButton::Left);   return 0;
+        case WM_LBUTTONUP:   self->leftDown = false;   self->pushInput(InputType::MouseUp,   MouseButton::Left);   return 0;
+        case WM_RBUTTONDOWN: self->rightDown = true;   self->pushInput(InputType::MouseDown, MouseButton::Right);  return 0;
+        case WM_RBUTTONUP:   self->rightDown = false;  self->pushInput(InputType::MouseUp,   MouseButton::Right);  return 0;
+        case WM_MBUTTONDOWN: self->middleDown = true;  self->pushInput(InputType::MouseDown, MouseButton::Middle); return 0;
+        case WM_MBUTTONUP:   self->middleDown = false; self->pushInput(InputType::MouseUp,   MouseButton::Middle); return 0;
         case WM_SYSCOMMAND:
             if ((wParam & 0xFFF0) == SC_MAXIMIZE) { self->setFullscreen(true); return 0; }
             if ((wParam & 0xFFF0) == SC_RESTORE)  { self->setFullscreen(false); return 0; }
@@ -586,7 +1812,17 @@ LRESULT CALLBACK Window::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
         case WM_PAINT: {
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
-            BitBlt(hdc, 0, 0, self->bufferWidth, self->bufferHeight, self->backDC, 0, 0, SRCCOPY);
+            int w, h;
+            const uint32_t* shown = self->internalWidth == 0 ? self->frameExport.publishedPixels(w, h) : nullptr;
+            if (shown) {
+                // Exporting at native resolution: the frame on screen lives in the ring
+                BITMAPINFO shownBmi = self->bmi;
+                shownBmi.bmiHeader.biWidth  = w;
+                shownBmi.bmiHeader.biHeight = -h;
+                StretchDIBits(hdc, 0, 0, w, h, 0, 0, w, h, shown, &shownBmi, DIB_RGB_COLORS, SRCCOPY);
+            } else {
+                BitBlt(hdc, 0, 0, self->windowWidth, self->windowHeight, self->backDC, 0, 0, SRCCOPY);
+            }
             EndPaint(hwnd, &ps);
             return 0;
         }
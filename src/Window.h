@@ -7,10 +7,13 @@
 #include <unordered_map>
 #include <emmintrin.h>
 #include <tmmintrin.h>
+#include <immintrin.h>
 #include <bits/algorithmfwd.h>
 #include <cmath>
 #include <vector>
 #include "font8x8/font8x8_basic.h"
+#include "InputQueue.h"
+#include "FrameExport.h"
 #include <algorithm>
 
 struct color {
@@ -68,6 +71,30 @@ static const struct color Violet      = { 238, 130, 238 };
 static const struct color Indigo      = { 75, 0, 130 };
 static const struct color Magenta     = { 255, 0, 255 };
 
+// Per-channel blend modes for the *Blend primitives. All are saturating
+// 8-bit integer ops: Add = min(d+s, 255), Multiply = d*s/255,
+// Screen = 255-(255-d)*(255-s)/255, Darken = min(d,s), Lighten = max(d,s)
+enum class BlendMode { Add, Multiply, Screen, Darken, Lighten };
+
+// Blend n pixels of src onto dst in place (SSE2, or AVX2 when the CPU has it)
+void blendSpan(uint32_t* dst, const uint32_t* src, int n, BlendMode mode);
+// Blend a solid 0x00BBGGRR color onto n pixels of dst
+void blendSpanSolid(uint32_t* dst, uint32_t src, int n, BlendMode mode);
+
+enum class LineJoin { Miter, Round, Bevel };
+enum class LineCap { Butt, Round, Square };
+
+struct StrokeStyle {
+    float width = 1.0f;
+    LineJoin join = LineJoin::Miter;
+    LineCap cap = LineCap::Butt;
+    float miterLimit = 4.0f; // longer miters fall back to bevel
+    bool antialias = false;
+};
+
+// Sub-pixel point for strokes, same coordinates as POINT: (x, y) is the center of pixel (x, y)
+struct StrokePt { float x, y; };
+
 #define fastMax(a, b) (a > b) ? a : b
 #define fastMin(a, b) (a < b) ? a : b
 
@@ -81,14 +108,28 @@ class Window {
         void writeSquare(int x, int y, int scale, color c);
         void writeRect(int x1, int y1, int xScale, int yScale, color c);
         void writePolygon(const std::vector<POINT>& pts, color c);
+        void writePolyline(const std::vector<POINT>& pts, const StrokeStyle& style, color c, bool closed = false);
+        void writeStrokePath(const std::vector<StrokePt>& pts, const StrokeStyle& style, color c, bool closed = false);
+        void writeStrokeRect(int x, int y, int w, int h, const StrokeStyle& style, color c);
+        void writeStrokePolygon(const std::vector<POINT>& pts, const StrokeStyle& style, color c);
+        void writeStrokeEllipse(int cx, int cy, int rx, int ry, const StrokeStyle& style, color c);
         void plotAA(int x, int y, float c, uint32_t packed);
         void writeCircle(int cx, int cy, int radius, color col);
         void writeEllipse(int x1, int y1, int xScale, int yScale, color c);
         void writeChar(int x, int y, WCHAR ch, color c);
         void writeText(int x, int y, const WCHAR * text, color c);
+        void writeMask(const uint8_t* mask, int maskW, int maskH, int dstX, int dstY, color c);
+        static void measureText(const WCHAR* text, int& w, int& h, int scale = 1, int lineSpacing = 0);
         void writeAlphaBitmap(uint32_t* srcPixels, int srcW, int srcH, int dstX, int dstY, BYTE alpha);
+        void writeRectBlend(int x, int y, int w, int h, color c, BlendMode mode);
+        void writeBitmapBlend(const uint32_t* srcPixels, int srcW, int srcH, int dstX, int dstY, BlendMode mode);
+        void writePointsBlend(const std::vector<POINT>& pts, color c, BlendMode mode);
+        void copyRect(int srcX, int srcY, int w, int h, int dstX, int dstY);
+        int scroll(int dx, int dy, const RECT& area, RECT* exposed = nullptr); // exposed: up to 2 rects
         HBITMAP loadBitmap(const WCHAR* filename, void** outPixels, int* w, int* h);
         void markDirty(int x, int y, int w, int h);
+        void pushClipRect(int x, int y, int w, int h);
+        void popClipRect();
 
         inline float getDeltaTime() const { return deltaTime; }
         inline float getFPS() const { return fps; }
@@ -99,11 +140,57 @@ class Window {
         inline bool isLeftDown() const { return leftDown; }
         inline bool isRightDown() const { return rightDown; }
         inline bool isMiddleDown() const { return middleDown; }
+
+        // Input events, in arrival order. Call once per frame before drawing.
+        bool pollEvent(InputEvent& e) {
+            if (!inputQueue.pop(e)) return false;
+            trackInputTime(e.timestamp);
+            return true;
+        }
+        template <typename F>
+        size_t drainEvents(F&& fn) {
+            return inputQueue.drain([&](const InputEvent& e) {
+                trackInputTime(e.timestamp);
+                fn(e);
+            });
+        }
+        // Seconds from the oldest event consumed for the last presented frame to that present
+        inline float getInputLatency() const { return inputLatency; }
+        inline uint64_t getDroppedEvents() const { return inputQueue.droppedCount(); }
         inline int getFrameWidth() const { return bufferWidth; }
         inline int getFrameHeight() const { return bufferHeight; }
         inline void getFrameSize(int& w, int& h) const { w = bufferWidth; h = bufferHeight; }
+        inline const RECT& getClipRect() const { return clipRect; }
+
+        // Draw into a w x h buffer and upscale it by the largest integer factor that
+        // fits the window on present (centered, black borders). Mouse coordinates
+        // are reported in internal space. Pass 0, 0 to render at window size again.
+        void setInternalResolution(int w, int h);
+        void setUpscaleFilter(bool bilinear) { upscaleBilinear = bilinear; letterboxDirty = true; }
+        inline int getUpscaleFactor() const { return upscaleFactor; }
+
+        // Allocate the draw buffers in a named shared-memory ring (see FrameExport.h)
+        // so another process can read each presented frame without a copy. Every
+        // present() moves drawing to the oldest slot; tiles that changed since that
+        // slot was last used are copied back from the last presented frame when
+        // first touched by a partial draw (like lazy clear), so setMarkDirty,
+        // scroll, copyRect and resizing keep working. A full writeBackground
+        // or opaque cover skips the copy.
+        bool enableFrameExport(const char* name, int slots = 3);
+        void disableFrameExport();
+        inline bool isFrameExportEnabled() const { return frameExport.isOpen(); }
 
         void setMarkDirty(bool set) { this->useMarkDirty = set; }
+        // writeBackground only marks 64x64 tiles as needing the clear; opaque rects
+        // and bitmaps that cover a tile cancel it, anything else clears the tile
+        // right before drawing into it, and present() clears the rest.
+        void setLazyClear(bool set) {
+            if (!set && pendingClears) resolveClearTiles(0, 0, bufferWidth, bufferHeight, false);
+            this->useLazyClear = set;
+        }
+        // Compare the frame against the last presented one at present() time and
+        // only upload tiles that changed. No markDirty bookkeeping needed.
+        void setAutoDirty(bool set) { this->useAutoDirty = set; prevFrame.clear(); }
         void createBackBuffer(int width, int height);
         bool update();
         void present();
@@ -123,14 +210,95 @@ class Window {
         int lastBkMode = -1;
         int bufferWidth = 0;
         int bufferHeight = 0;
+        int bufferStride = 0;  // pixels between rows of pixelBuffer, >= bufferWidth
+        BITMAPINFO bufferBmi = {};
+
+        // Window sized DIB pixels. Same as pixelBuffer unless an internal resolution is set.
+        void* windowPixels = nullptr;
+        int windowWidth = 0;
+        int windowHeight = 0;
+        int windowStride = 0;
+        int windowCapWidth = 0;  // allocated DIB size
+        int windowCapHeight = 0;
+
+        // Internal resolution
+        std::vector<uint32_t> internalPixels;
+        int internalWidth = 0;  // 0 = disabled
+        int internalHeight = 0;
+        int upscaleFactor = 1;
+        int upscaleOffsetX = 0; // where the upscaled image starts in the window
+        int upscaleOffsetY = 0;
+        bool upscaleBilinear = false;
+        bool letterboxDirty = true;
+        std::vector<uint32_t> upscaleRow;
+        // Bilinear column table for the visible output span, rebuilt on layout change:
+        // left source pixel, then 256 - wx four times and wx four times per column
+        std::vector<int> bilerpSrcX;
+        std::vector<uint16_t> bilerpWeightX;
+        void updateUpscaleLayout();
+        void selectDrawBuffer();
+
+        // Shared-memory frame export
+        FrameExportWriter frameExport;
+        RECT exportChanges[FRAME_EXPORT_MAX_SLOTS] = {}; // changed area of recent presents, newest first
+        int exportChangeCount = 0;
+        void markRestore(int left, int top, int right, int bottom);
+        bool restoreSource(const uint32_t*& px, int& stride, int& w, int& h) const;
+        void upscaleToWindow();
         WINDOWPLACEMENT prevPlacement = { sizeof(prevPlacement) };
         BITMAPINFO bmi = {};
 
+        // Clip rect stack, clipRect is the top intersected with the buffer
+        std::vector<RECT> clipStack;
+        RECT clipRect = {0,0,0,0};
+        void updateClipRect();
+        void fillClippedSpan(int y, int xL, int xR, uint32_t packed);
+        inline bool clipReject(int left, int top, int right, int bottom) const {
+            return right <= clipRect.left || bottom <= clipRect.top ||
+                   left >= clipRect.right || top >= clipRect.bottom;
+        }
+
         // Dirty rect
         RECT dirtyRect = {0,0,0,0};
         bool hasDirty = false;
         bool isAllDirty = false;
         bool useMarkDirty = false;
+
+        // Lazy clear
+        static constexpr int clearTileSize = 64;
+        bool useLazyClear = false;
+        uint32_t clearColor = 0;
+        // 1 = tile still needs clearColor, 2 = tile still needs the last presented
+        // frame copied back in (frame export, see markRestore)
+        std::vector<uint8_t> clearTiles;
+        int clearTilesX = 0;
+        int clearTilesY = 0;
+        int pendingClears = 0;
+        void resolveClearTiles(int left, int top, int right, int bottom, bool opaque);
+        // Clipped to the clip rect, since nothing is drawn outside it
+        inline void resolveClear(int left, int top, int right, int bottom) {
+            if (!pendingClears) return;
+            resolveClearTiles(fastMax(left, (int)clipRect.left), fastMax(top, (int)clipRect.top),
+                              fastMin(right, (int)clipRect.right), fastMin(bottom, (int)clipRect.bottom), false);
+        }
+        // Single pixel inside the buffer; for primitives that plot pixel by pixel
+        inline void resolveClearAt(int x, int y) {
+            if (pendingClears && clearTiles[(y / clearTileSize) * clearTilesX + x / clearTileSize]) {
+                resolveClearTiles(x, y, x + 1, y + 1, false);
+            }
+        }
+        inline void coverClear(int left, int top, int right, int bottom) {
+            if (!pendingClears) return;
+            resolveClearTiles(fastMax(left, (int)clipRect.left), fastMax(top, (int)clipRect.top),
+                              fastMin(right, (int)clipRect.right), fastMin(bottom, (int)clipRect.bottom), true);
+        }
+
+        // Automatic dirty tiles
+        static constexpr int diffTileSize = 64;
+        bool useAutoDirty = false;
+        std::vector<uint32_t> prevFrame;  // copy of the last presented frame
+        std::vector<uint8_t> changedTiles;
+        void presentChangedTiles(HDC hdc);
         
         // Mouse stuff
         int mouseX = 0;
@@ -139,6 +307,16 @@ class Window {
         bool rightDown  = false;
         bool middleDown = false;
 
+        // Input queue, filled by windowProc
+        InputQueue inputQueue;
+        uint64_t pendingInputTime = 0; // oldest event consumed since the last present
+        float inputLatency = 0.0f;
+        void pushInput(InputType type, MouseButton button = MouseButton::None, uint32_t key = 0, int wheel = 0, bool repeat = false);
+        inline void trackInputTime(uint64_t t) {
+            if (pendingInputTime == 0 || t < pendingInputTime) pendingInputTime = t;
+        }
+        void recordInputLatency();
+
         // FPS
         std::chrono::high_resolution_clock::time_point lastFrame;
         float deltaTime = 0.0f;
@@ -0,0 +1,126 @@
+// Reference consumer for Window::enableFrameExport.
+//
+//   FrameConsumer <name> [frames]   read frames published by a running app
+//   FrameConsumer --self-test       run a producer thread and check every frame read
+//
+// Frames are read in place; nothing is copied out of the shared ring.
+#include "../FrameExport.h"
+#include "../InputQueue.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static uint32_t checksum(const uint32_t* px, int count) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < count; ++i) h = (h ^ px[i]) * 16777619u;
+    return h;
+}
+
+static int consume(const char* name, int maxFrames) {
+    FrameExportReader reader;
+    uint64_t lastFrame = 0;
+    int got = 0, torn = 0;
+    while (got < maxFrames) {
+        if (!reader.isOpen() || reader.isClosed()) {
+            if (!reader.open(name)) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); continue; }
+        }
+        FrameInfo info;
+        const uint32_t* px = reader.acquireLatest(info);
+        if (!px || info.frame == lastFrame) { std::this_thread::yield(); continue; }
+
+        uint32_t sum = checksum(px, info.width * info.height);
+        if (!reader.stillValid(info)) { ++torn; continue; } // producer lapped us mid-read
+        printf("frame %llu  %dx%d  checksum %08x  age %.3f ms  skipped %llu\n",
+               (unsigned long long)info.frame, info.width, info.height, sum,
+               (inputNow() - info.timestamp) / 1e6,
+               (unsigned long long)(lastFrame ? info.frame - lastFrame - 1 : 0));
+        lastFrame = info.frame;
+        ++got;
+    }
+    printf("%d frames, %d torn reads dropped\n", got, torn);
+    return 0;
+}
+
+// Producer writes frame number + pixel index into every pixel, so a reader can
+// verify each frame it accepts is complete and not mixed with another frame.
+// The producer may run a few frames ahead of the reader, enough to lap the
+// ring, and grows the frame twice while the reader is attached.
+static int selfTest() {
+    const char* name = "Simple2dFrameExportSelfTest";
+    const int frames = 3000;
+    const int maxLead = 4; // frames the producer may run ahead; more than the 3 slots
+    FrameExportWriter writer;
+    if (!writer.open(name, 64, 48)) { printf("FAIL: could not create shared memory\n"); return 1; }
+
+    std::atomic<uint64_t> seen{0};
+    std::atomic<bool> stop{false};
+    bool producerFailed = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+    std::thread producer([&] {
+        for (int f = 1; f <= frames && !stop; ++f) {
+            while ((uint64_t)f > seen.load() + maxLead && !stop) std::this_thread::yield();
+            int phase = f * 3 / (frames + 1); // each size change reallocates the ring
+            int w = phase == 0 ? 64 : (phase == 1 ? 160 : 320);
+            int h = phase == 0 ? 48 : (phase == 1 ? 90 : 180);
+            uint32_t* px = writer.beginFrame(w, h);
+            if (!px) { producerFailed = true; stop = true; break; }
+            for (int i = 0; i < w * h; ++i) px[i] = (uint32_t)f + (uint32_t)i;
+            writer.publish();
+        }
+    });
+
+    FrameExportReader reader;
+    int checked = 0, bad = 0, torn = 0, opens = 0;
+    int checkedPerSize[3] = {};
+    uint32_t lastGeneration = 0;
+    uint64_t last = 0;
+    while (last < (uint64_t)frames && !stop) {
+        if (std::chrono::steady_clock::now() > deadline) { stop = true; break; }
+        if (!reader.isOpen() || reader.isClosed()) {
+            if (!reader.open(name)) { std::this_thread::yield(); continue; }
+            if (reader.getGeneration() != lastGeneration) ++opens;
+            lastGeneration = reader.getGeneration();
+        }
+        FrameInfo info;
+        const uint32_t* px = reader.acquireLatest(info);
+        if (!px || info.frame == last) { std::this_thread::yield(); continue; }
+        seen = info.frame; // let the producer go on and possibly lap this slot mid-check
+        int count = info.width * info.height;
+        bool ok = true;
+        for (int i = 0; i < count && ok; ++i) {
+            // Now and then stall halfway so the producer really does lap this slot
+            if (i == count / 2 && info.frame % 16 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            if (px[i] != (uint32_t)info.frame + (uint32_t)i) ok = false;
+        }
+        if (!reader.stillValid(info)) { ++torn; continue; } // torn read, correctly detected
+        if (!ok) ++bad;
+        ++checked;
+        ++checkedPerSize[info.width == 64 ? 0 : (info.width == 160 ? 1 : 2)];
+        last = info.frame;
+    }
+    stop = true;
+    producer.join();
+    writer.close();
+
+    // The reader must have kept up, caught the laps and followed both reallocations
+    bool enough = checked >= frames / 10 && torn > 0 && opens == 3 &&
+                  checkedPerSize[1] >= frames / 20 && checkedPerSize[2] >= frames / 20;
+    bool pass = !bad && !producerFailed && enough && last == (uint64_t)frames;
+    printf("%s: %d frames checked (%d/%d/%d per size), %d corrupt, %d torn reads dropped, %d rings opened%s\n",
+           pass ? "PASS" : "FAIL", checked, checkedPerSize[0], checkedPerSize[1], checkedPerSize[2],
+           bad, torn, opens, producerFailed ? ", producer lost the ring" : "");
+    return pass ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--self-test") == 0) return selfTest();
+    if (argc < 2) {
+        printf("usage: %s <name> [frames] | --self-test\n", argv[0]);
+        return 2;
+    }
+    return consume(argv[1], argc > 2 ? atoi(argv[2]) : 100);
+}
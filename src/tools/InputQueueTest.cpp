@@ -0,0 +1,145 @@
+// Self-test and benchmark for the SpscRing behind Window's input queue.
+//
+//   InputQueueTest              run all checks (same as --self-test)
+//   InputQueueTest --self-test  run all checks
+//   InputQueueTest --bench      only time a producer thread feeding a consumer
+//
+// Every event carries a sequence number in its timestamp field so the consumer
+// can check ordering and count exactly what was lost.
+#include "../InputQueue.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+typedef SpscRing<InputEvent, 1024> TestRing;
+
+static InputEvent makeEvent(uint64_t seq) {
+    InputEvent e = {};
+    e.timestamp = seq;
+    e.type = InputType::MouseMove;
+    e.x = (int)seq;
+    e.y = -(int)seq;
+    return e;
+}
+
+static bool sameEvent(const InputEvent& e, uint64_t seq) {
+    return e.timestamp == seq && e.x == (int)seq && e.y == -(int)seq;
+}
+
+// Filling the ring with nobody reading: exactly Capacity pushes succeed, every
+// push after that is refused and counted, and the queued events come out intact.
+static bool testOverflowExact() {
+    static TestRing ring;
+    const uint64_t extra = 37;
+    uint64_t accepted = 0, refused = 0;
+    for (uint64_t i = 0; i < ring.capacity() + extra; ++i) {
+        if (ring.push(makeEvent(i))) ++accepted; else ++refused;
+    }
+    bool ok = accepted == ring.capacity() && refused == extra &&
+              ring.droppedCount() == extra && ring.size() == ring.capacity();
+
+    uint64_t expect = 0;
+    size_t drained = ring.drain([&](const InputEvent& e) {
+        if (!sameEvent(e, expect)) ok = false;
+        ++expect;
+    });
+    ok = ok && drained == ring.capacity() && ring.empty();
+
+    // Usable again after draining, and the drop count is not reset
+    InputEvent e;
+    ok = ok && ring.push(makeEvent(1000)) && ring.pop(e) && sameEvent(e, 1000) &&
+         !ring.pop(e) && ring.droppedCount() == extra;
+
+    printf("%s: overflow with no reader, %llu accepted, %llu dropped\n", ok ? "PASS" : "FAIL",
+           (unsigned long long)accepted, (unsigned long long)ring.droppedCount());
+    return ok;
+}
+
+// Producer thread never pushes into a full ring, so nothing may be lost; the
+// consumer alternates pop() and drain() and checks every sequence number.
+static bool testNoLoss(uint64_t count) {
+    static TestRing ring;
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < count; ++i) {
+            while (ring.size() == ring.capacity()) std::this_thread::yield();
+            ring.push(makeEvent(i));
+        }
+    });
+
+    uint64_t start = inputNow();
+    uint64_t expect = 0, bad = 0;
+    bool usePop = true;
+    while (expect < count) {
+        size_t got;
+        if (usePop) {
+            InputEvent e;
+            got = ring.pop(e);
+            if (got) { bad += !sameEvent(e, expect); ++expect; }
+        } else {
+            got = ring.drain([&](const InputEvent& e) { bad += !sameEvent(e, expect); ++expect; });
+        }
+        usePop = !usePop;
+        if (!got) std::this_thread::yield(); // let the producer run on a single core
+    }
+    producer.join();
+    double seconds = (inputNow() - start) / 1e9;
+
+    bool ok = bad == 0 && ring.droppedCount() == 0 && ring.empty();
+    printf("%s: %llu events across threads, %llu out of order, %llu dropped, %.1f ns/event\n",
+           ok ? "PASS" : "FAIL", (unsigned long long)count, (unsigned long long)bad,
+           (unsigned long long)ring.droppedCount(), seconds * 1e9 / count);
+    return ok;
+}
+
+// Producer pushes regardless while the consumer lags behind. Whatever arrives
+// must still be in order, and received + dropped must account for every push.
+static bool testOverflowConcurrent(uint64_t count) {
+    static TestRing ring;
+    std::atomic<bool> done{false};
+    uint64_t refused = 0;
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < count; ++i) {
+            if (!ring.push(makeEvent(i))) ++refused;
+        }
+        done = true;
+    });
+
+    uint64_t received = 0, outOfOrder = 0, last = 0;
+    bool first = true;
+    auto check = [&](const InputEvent& e) {
+        if (!first && e.timestamp <= last) ++outOfOrder;
+        if (e.x != (int)e.timestamp || e.y != -(int)e.timestamp) ++outOfOrder;
+        last = e.timestamp;
+        first = false;
+        ++received;
+    };
+    while (!done) {
+        ring.drain(check);
+        // Fall behind on purpose so the ring fills up
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    producer.join();
+    ring.drain(check);
+
+    uint64_t dropped = ring.droppedCount();
+    bool ok = outOfOrder == 0 && dropped == refused && received + dropped == count && dropped > 0;
+    printf("%s: slow reader, %llu received, %llu dropped (%llu refused), %llu out of order\n",
+           ok ? "PASS" : "FAIL", (unsigned long long)received, (unsigned long long)dropped,
+           (unsigned long long)refused, (unsigned long long)outOfOrder);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return testNoLoss(10000000) ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "--self-test") != 0) {
+        printf("usage: %s [--self-test | --bench]\n", argv[0]);
+        return 2;
+    }
+    bool ok = testOverflowExact();
+    ok = testNoLoss(2000000) && ok;
+    ok = testOverflowConcurrent(2000000) && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}